@@ -12,7 +12,15 @@
 #include <stdlib.h>
 #include <math.h>  
 #include <unordered_map>
+#include <stdint.h>
+#include <thread>
 #include "pythonpp.h"
+#include "tokenizer.h"
+#include "scoringPipeline.h"
+#include "scoringServer.h"
+#include "profiler.h"
+#include "prunedScoring.h"
+#include "compactCounts.h"
 
 
 using namespace std;
@@ -24,11 +32,22 @@ class NaiveBayes {
         // Probabilities for each class in the training set
         unordered_map<int, double> classProbabilities;
 
-        // Matrix of word counts in a class
-        vector<vector<int>> countMatrix;
+        // Matrix of word counts in a class, one row per class in the narrowest width that holds it
+        vector<compactCountRow> countMatrix;
 
-        // Matrix of word log probabilities in a class
-        vector<vector<double>> probMatrix;
+        // Sparse smoothed log counts. For every feature column, (class, log2(count + beta) - log2(beta)) for the
+        // classes whose count is not zero. The word log probability is log2(beta) + that gain - logDenominator[class],
+        // so words a class never saw need no stored log at all.
+        vector<vector<pair<int, double>>> wordLogCounts;
+
+        // log2(beta), the smoothed log count of every zero cell
+        double logBeta;
+
+        // Log of the smoothed word total of each class, log2(rawCount + beta * |V|)
+        vector<double> logDenominator;
+
+        // Set when documents were added since the class priors were computed
+        bool priorsStale;
 
         // Alpha
         double alpha;
@@ -51,160 +70,1072 @@ class NaiveBayes {
         // Vector containing total representation for each class
         vector<int> classRepresentation;
 
-        NaiveBayes(string file, string vocab_file, string labels_file, double b) {
-            countMatrix = read_csv_int(file);
+        // Vocabulary indices the model is built on, column j of countMatrix is word featureMask[j]
+        vector<int> featureMask;
+
+        // Column of every vocabulary word in countMatrix, -1 for words outside the mask
+        vector<int> featureColumn;
+
+        // Number of hashed feature bits when the model was trained with the hashing trick, 0 when it uses the vocabulary
+        int hashBits;
+
+        // Bits of the quantized scoring tables, 0 when the model was not quantized
+        int quantBits;
+
+        // Set when gains changed since the quantized tables were built
+        bool quantStale;
+
+        // Quantized word gains, one column per feature so a word's classes are contiguous.
+        // int16 tables share one scale per class, int8 tables one scale per feature column.
+        Matrix<int16_t, Dynamic, Dynamic> quantTable16;
+        Matrix<int8_t, Dynamic, Dynamic> quantTable8;
+
+        // Gain represented by one quantization step, per class (16 bits) or one entry shared by all columns (8 bits)
+        VectorXd quantStep;
+
+        // Scale of every int8 column as a power of two of the shared step, so counts can be shifted instead of
+        // multiplied by a double
+        vector<int> quantShift;
+
+        // Dense classes x columns copy of the gains and the bounds of every column, empty unless pruning is enabled
+        MatrixXd pruningGains;
+        VectorXd pruningUpper;
+        VectorXd pruningLower;
+
+        NaiveBayes(string file, string vocab_file, string labels_file, double b, const vector<int>& mask = vector<int>()) {
+            scopedTimer timer("nb_construct");
+            vector<vector<int>> counts = read_csv_int(file);
+            hashBits = 0;
+            quantBits = 0;
+            quantStale = false;
 
             // Load labels and vocab from files
             vocab = read_lines(vocab_file);
             label_vocab = read_lines(labels_file);
 
-            if (b > 0) {
-                beta = b;
-                alpha = 1 + b;
-                cout << "Alpha: " << alpha << endl;
+            // Restrict the model to the selected words, or keep the whole vocabulary
+            featureMask = mask;
+            if (featureMask.empty()) {
+                for (int j = 0; j < vocab.size(); j++) {
+                    featureMask.push_back(j);
+                }
             } else {
-                beta = (1.0/(double) vocab.size());
-                alpha = 1 + beta;
-                cout << "Alpha: " << alpha << endl;
+                for (int i = 0; i < counts.size(); i++) {
+                    vector<int> selected;
+                    for (int j : featureMask) {
+                        selected.push_back(counts.at(i).at(j));
+                    }
+                    counts.at(i) = selected;
+                }
             }
-            
 
-            // Preprocess Probability matrix
-            for(int i=0; i<countMatrix.size(); i++){
-                vector<double> temp((int) countMatrix.at(i).size(), 0.0);
-                probMatrix.push_back(temp);
+            featureColumn.assign(vocab.size(), -1);
+            for (int j = 0; j < featureMask.size(); j++) {
+                featureColumn.at(featureMask[j]) = j;
             }
 
             // Load preprocessed data into model
             rawCount = read_vec_int("rawCount.vec");
             classRepresentation = read_vec_int("classRepresentation.vec");
 
-            numberOfDcuments = 0;   // Sum of class representations
+            // Word totals per class only cover the selected words
+            if (featureMask.size() < vocab.size()) {
+                for (int i = 0; i < counts.size(); i++) {
+                    rawCount.at(i) = 0;
+                    for (int count : counts.at(i)) {
+                        rawCount.at(i) += count;
+                    }
+                }
+            }
 
-            // Calculate number of documents
-            for (int i : classRepresentation) {
-                numberOfDcuments = numberOfDcuments + i;
+            storeCounts(counts);
+            train(b, (int) vocab.size());
+        }
+
+        // Train on raw text documents with the hashing trick instead of a vocabulary. Every line of the
+        // list file is "<path>,<class>" and words are counted in 2^bits hashed slots. Hashing is unsigned
+        // here because the multinomial model needs non-negative counts.
+        NaiveBayes(string documentList, string labels_file, int bits, double b) {
+            scopedTimer timer("nb_construct");
+            label_vocab = read_lines(labels_file);
+            hashBits = bits;
+            quantBits = 0;
+            quantStale = false;
+            int numFeatures = 1 << bits;
+            int numClasses = (int) label_vocab.size();
+
+            vector<vector<int>> counts(numClasses, vector<int>(numFeatures, 0));
+            rawCount.assign(numClasses, 0);
+            classRepresentation.assign(numClasses, 0);
+
+            vector<vector<string>> documents = read_csv(documentList);
+            for (int i = 0; i < documents.size(); i++) {
+                int _class = stoi(documents.at(i).at(1)) - 1;
+                classRepresentation.at(_class) += 1;
+                for (const pair<int, int>& word : hashFile(documents.at(i).at(0), bits, false)) {
+                    counts.at(_class).at(word.first) += word.second;
+                    rawCount.at(_class) += word.second;
+                }
             }
 
-            fillClassProbabilities();
-            fillProbabilityMatrix();
+            for (int j = 0; j < numFeatures; j++) {
+                featureMask.push_back(j);
+            }
+            featureColumn = featureMask;
+
+            storeCounts(counts);
+            train(b, numFeatures);
         }
 
+        // Build a model from count tables already in memory, over the whole vocabulary. verbose = false keeps
+        // the constructor silent, for models built on worker threads.
+        NaiveBayes(const vector<vector<int>>& counts, const vector<int>& classCounts, const vector<string>& vocabulary,
+                   const vector<string>& labels, double b, bool verbose = true) {
+            scopedTimer timer("nb_construct");
+            storeCounts(counts);
+            classRepresentation = classCounts;
+            vocab = vocabulary;
+            label_vocab = labels;
+            hashBits = 0;
+            quantBits = 0;
+            quantStale = false;
+
+            rawCount.assign(counts.size(), 0);
+            for (int i = 0; i < counts.size(); i++) {
+                for (int count : counts.at(i)) {
+                    rawCount.at(i) += count;
+                }
+            }
+            for (int j = 0; j < vocab.size(); j++) {
+                featureMask.push_back(j);
+            }
+            featureColumn = featureMask;
+
+            train(b, (int) vocab.size(), verbose);
+        }
+
+        // Score a count file on every core. Rows are parsed straight into sparse documents, and results are
+        // written in file order to submission.csv, or counted against the last column for labelled files.
         void testModel(string file, bool produceSubmissionFile) {
-            chrono::steady_clock::time_point begin;
-            chrono::steady_clock::time_point end;
-            chrono::steady_clock::time_point begin1;
-            chrono::steady_clock::time_point end1;
-            begin = chrono::steady_clock::now();
-            vector<vector<int>> data = read_csv_int(file);
-            end = chrono::steady_clock::now();
-            std::cout << "Time to read file = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+            scopedTimer timer("nb_test_model");
+            // Priors are refreshed up front, predict must not modify the model once the workers run
+            if (priorsStale) fillClassProbabilities();
+            // Count csv files are streamed, sparse binary corpora written by generate.out are read at once
+            function<int(const sparseDocument&)> predictDocument = [this](const sparseDocument& document) { return predict(document); };
+            string submissionFile = produceSubmissionFile ? "submission.csv" : "";
+            pipelineStats stats = isSparseBinary(file)
+                                  ? scoreSparseBinary(file, (int) featureColumn.size(), !produceSubmissionFile, predictDocument, submissionFile)
+                                  : scoreCsvPipelined(file, (int) featureColumn.size(), !produceSubmissionFile, predictDocument, submissionFile, 12001);
+            printPipelineStats(stats);
+
+            if (!produceSubmissionFile) {
+                double correct = (double) stats.correct;
+                double total = (double) stats.rows;
+                ofstream record;
+                record.open("last_run_info.txt");
+                record << "Total: " << total << endl << "Correct: " << correct << endl << "Accuracy: " << (correct/total) * 100 << "%" << endl;
+                record.close();
+            }
+        }
+
+        // Classify raw text documents. Every line of the list file is a path, optionally followed by ",<class>".
+        // Documents are tokenized straight into sparse counts, no count matrix is built.
+        void testDocuments(string file, bool produceSubmissionFile) {
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            perfectHashVocabulary lookup(vocab);
+            chrono::steady_clock::time_point end = chrono::steady_clock::now();
+            std::cout << "Time to hash vocabulary = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
             begin = chrono::steady_clock::now();
+            vector<vector<string>> documents = read_csv(file);
             if (produceSubmissionFile) {
-                data = seperateTargets(data, 0).first;
-                // data = seperateTargets(data, data.at(0).size()).first;
-
-                // Crete submission file
                 ofstream submission;
                 submission.open("submission.csv");
                 submission << "id,class" << endl;
-                begin1 = chrono::steady_clock::now();
-                for (int i = 0; i < data.size(); i++) {
-                    submission << 12001 + i << "," << predict(data.at(i)) << endl;
+                for (int i = 0; i < documents.size(); i++) {
+                    submission << 12001 + i << "," << predict(readDocument(documents.at(i).at(0), lookup)) << "\n";
                 }
-                end1 = chrono::steady_clock::now();
-                std::cout << "Time to predict = " << std::chrono::duration_cast<std::chrono::milliseconds>(end1 - begin1).count() << "[ms]" << std::endl;
                 submission.close();
             } else {
-                data = seperateTargets(data, 0).first;
-                vector<int> Y = seperateTargets(data, data.at(0).size() - 1).second;
-                data = seperateTargets(data, data.at(0).size() - 1).first;
-
-                // Crete file to rec
-                ofstream record;
-                record.open("last_run_info.txt");
-
                 double correct = 0.0;
                 double total = 0.0;
-
-                for (int i = 0; i < Y.size(); i++) {
-                    if (predict(data.at(i)) == Y.at(i)) {
+                for (int i = 0; i < documents.size(); i++) {
+                    if (predict(readDocument(documents.at(i).at(0), lookup)) == stoi(documents.at(i).at(1))) {
                         correct = correct + 1.0;
                     }
                     total = total + 1.0;
                 }
 
+                ofstream record;
+                record.open("last_run_info.txt");
                 record << "Total: " << total << endl << "Correct: " << correct << endl << "Accuracy: " << (correct/total) * 100 << "%" << endl;
                 record.close();
             }
             end = chrono::steady_clock::now();
-            std::cout << "Total time to predict classes = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;     
+            std::cout << "Total time to tokenize and predict = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+        }
+
+        // Add one labelled document (classes start at 1) to the model. Only the cells of the words it
+        // contains and the denominator of its class are recomputed, the priors are refreshed lazily.
+        void update(const sparseDocument& document, int label) {
+            int i = label - 1;
+            for (const pair<int, int>& word : document) {
+                int column = featureColumn[word.first];
+                if (column < 0) continue;
+                countMatrix.at(i).add(column, word.second);
+                rawCount.at(i) += word.second;
+                refreshCell(i, column);
+            }
+            refreshDenominator(i);
+            classRepresentation.at(i) += 1;
+            numberOfDcuments += 1;
+            priorsStale = true;
+        }
+
+        // Add a batch of labelled documents, recomputing every touched cell and class once
+        void updateBatch(const vector<sparseDocument>& documents, const vector<int>& labels) {
+            vector<pair<int, int>> touched;
+            vector<bool> touchedClass(classRepresentation.size(), false);
+            for (int d = 0; d < documents.size(); d++) {
+                int i = labels.at(d) - 1;
+                for (const pair<int, int>& word : documents.at(d)) {
+                    int column = featureColumn[word.first];
+                    if (column < 0) continue;
+                    countMatrix.at(i).add(column, word.second);
+                    rawCount.at(i) += word.second;
+                    touched.push_back(make_pair(i, column));
+                }
+                touchedClass.at(i) = true;
+                classRepresentation.at(i) += 1;
+                numberOfDcuments += 1;
+            }
+            sort(touched.begin(), touched.end());
+            touched.erase(unique(touched.begin(), touched.end()), touched.end());
+            for (const pair<int, int>& cell : touched) {
+                refreshCell(cell.first, cell.second);
+            }
+            for (int i = 0; i < touchedClass.size(); i++) {
+                if (touchedClass[i]) refreshDenominator(i);
+            }
+            priorsStale = true;
+        }
+
+        // Dense count rows in the layout of the test files (vocabulary columns only)
+        void update(const vector<int>& features, int label) {
+            sparseDocument document;
+            for (int j = 0; j < features.size(); j++) {
+                if (features[j] != 0) document.push_back(make_pair(j, features[j]));
+            }
+            update(document, label);
+        }
+
+        // Prequential run over a labelled count file: predict every row, then learn from it
+        void testThenTrain(string file) {
+            vector<vector<int>> data = read_csv_int(file);
+            stripColumn(data, 0);
+            vector<int> Y = stripColumn(data, data.at(0).size() - 1);
+
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            double correct = 0.0;
+            double total = 0.0;
+            for (int i = 0; i < Y.size(); i++) {
+                if (predict(data.at(i)) == Y.at(i)) {
+                    correct = correct + 1.0;
+                }
+                total = total + 1.0;
+                update(data.at(i), Y.at(i));
+            }
+            chrono::steady_clock::time_point end = chrono::steady_clock::now();
+            std::cout << "Time to predict and update = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+            ofstream record;
+            record.open("last_run_info.txt");
+            record << "Total: " << total << endl << "Correct: " << correct << endl << "Accuracy: " << (correct/total) * 100 << "%" << endl;
+            record.close();
+        }
+
+        // Build quantized copies of the nonzero word gains with 16 or 8 bit entries. Priors and the
+        // zero count term stay in double, they are added once per document. Updates to the model
+        // rebuild the tables on the next quantized prediction.
+        void quantize(int bits) {
+            if (bits != 8 && bits != 16) throw runtime_error("Quantization supports 8 or 16 bits");
+            quantBits = bits;
+            buildQuantizedTables();
+            cout << "Quantized table size: " << (size_t) countMatrix.size() * featureMask.size() * (bits / 8) << " bytes" << endl;
+        }
+
+        // Score a labelled count file with the double and the quantized model and report how often they agree
+        void compareQuantized(string file) {
+            vector<vector<int>> data = read_csv_int(file);
+            stripColumn(data, 0);
+            vector<int> Y = stripColumn(data, data.at(0).size() - 1);
+
+            vector<sparseDocument> documents(data.size());
+            for (int i = 0; i < data.size(); i++) {
+                for (int j = 0; j < data.at(i).size(); j++) {
+                    if (data.at(i).at(j) != 0) documents[i].push_back(make_pair(j, data.at(i).at(j)));
+                }
+            }
+
+            vector<int> exact(documents.size());
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            for (int i = 0; i < documents.size(); i++) {
+                exact[i] = predict(documents[i]);
+            }
+            chrono::steady_clock::time_point end = chrono::steady_clock::now();
+            std::cout << "Time to predict with double tables = " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << "[us]" << std::endl;
+
+            vector<int> quantized(documents.size());
+            begin = chrono::steady_clock::now();
+            for (int i = 0; i < documents.size(); i++) {
+                quantized[i] = predictQuantized(documents[i]);
+            }
+            end = chrono::steady_clock::now();
+            std::cout << "Time to predict with int" << quantBits << " tables = " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << "[us]" << std::endl;
+
+            double agree = 0.0;
+            double correct = 0.0;
+            double correctExact = 0.0;
+            double total = 0.0;
+            for (int i = 0; i < Y.size(); i++) {
+                if (quantized[i] == exact[i]) agree = agree + 1.0;
+                if (quantized[i] == Y.at(i)) correct = correct + 1.0;
+                if (exact[i] == Y.at(i)) correctExact = correctExact + 1.0;
+                total = total + 1.0;
+            }
+            std::cout << "Agreement with double model = " << (agree/total) * 100 << "%" << std::endl;
+
+            ofstream record;
+            record.open("last_run_info.txt");
+            record << "Total: " << total << endl << "Correct: " << correct << endl << "Accuracy: " << (correct/total) * 100 << "%" << endl;
+            record << "Double model accuracy: " << (correctExact/total) * 100 << "%" << endl << "Agreement: " << (agree/total) * 100 << "%" << endl;
+            record.close();
+        }
+
+        // Score a labelled count file under many smoothing betas at once. The smoothed log counts of every
+        // nonzero cell are packed beta-major next to each other, so each document is read and walked once and
+        // every word updates all betas of a class in one contiguous run. Writes the accuracy per beta to last_run_info.txt.
+        void sweepBetas(const vector<double>& betas, string file, int numThreads) {
+            scopedTimer timer("nb_beta_sweep");
+            if (priorsStale) fillClassProbabilities();
+            int numBetas = (int) betas.size();
+            int numClasses = (int) countMatrix.size();
+            int numColumns = (int) featureMask.size();
+
+            // Nonzero cells of every column, and log2(count + beta) - log2(beta) for each of them and each beta
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            vector<double> smoothing(numBetas);
+            for (int b = 0; b < numBetas; b++) {
+                smoothing[b] = betas[b] > 0 ? betas[b] : 1.0 / (double) featureColumn.size();
+            }
+            // Most counts are small, their gains are computed once per beta instead of once per cell
+            const int numSmallCounts = 256;
+            vector<double> smallGains((size_t) numSmallCounts * numBetas);
+            for (int count = 0; count < numSmallCounts; count++) {
+                for (int b = 0; b < numBetas; b++) {
+                    smallGains[(size_t) count * numBetas + b] = log2(count + smoothing[b]) - log2(smoothing[b]);
+                }
+            }
+            size_t nonzeros = 0;
+            for (int i = 0; i < numClasses; i++) {
+                nonzeros += countMatrix.at(i).nonzeros();
+            }
+            vector<int> columnStart(numColumns + 1, 0);
+            vector<int> cellClass;
+            vector<double> cellGains;
+            cellClass.reserve(nonzeros);
+            cellGains.reserve(nonzeros * numBetas);
+            for (int j = 0; j < numColumns; j++) {
+                columnStart[j] = (int) cellClass.size();
+                for (int i = 0; i < numClasses; i++) {
+                    int count = countMatrix.at(i).at(j);
+                    if (count == 0) continue;
+                    cellClass.push_back(i);
+                    for (int b = 0; b < numBetas; b++) {
+                        if (count > 0 && count < numSmallCounts) cellGains.push_back(smallGains[(size_t) count * numBetas + b]);
+                        else cellGains.push_back(log2(count + smoothing[b]) - log2(smoothing[b]));
+                    }
+                }
+            }
+            columnStart[numColumns] = (int) cellClass.size();
+
+            // log2(beta) - log2(rawCount + beta * |V|), paid once per counted word
+            vector<double> lengthTerms((size_t) numClasses * numBetas);
+            for (int i = 0; i < numClasses; i++) {
+                for (int b = 0; b < numBetas; b++) {
+                    lengthTerms[(size_t) i * numBetas + b] = log2(smoothing[b]) - log2((double) rawCount.at(i) + smoothing[b] * numColumns);
+                }
+            }
+            chrono::steady_clock::time_point end = chrono::steady_clock::now();
+            std::cout << "Time to fill " << numBetas << " tables = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+            begin = chrono::steady_clock::now();
+            vector<sparseDocument> documents;
+            vector<int> ids;
+            vector<int> labels;
+            if (!readSparseCsv(file, (int) featureColumn.size(), documents, ids, labels)) throw runtime_error("The beta sweep needs a labelled file");
+            end = chrono::steady_clock::now();
+            std::cout << "Time to read " << documents.size() << " documents = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+            // Every thread scores a contiguous range of documents and counts its own hits per beta
+            begin = chrono::steady_clock::now();
+            if (numThreads <= 0) numThreads = max(1, (int) thread::hardware_concurrency());
+            vector<vector<int>> threadCorrect(numThreads, vector<int>(numBetas, 0));
+            vector<thread> workers;
+            for (int t = 0; t < numThreads; t++) {
+                workers.push_back(thread([&, t]() {
+                    vector<double> scores((size_t) numClasses * numBetas);
+                    size_t first = documents.size() * t / numThreads;
+                    size_t last = documents.size() * (t + 1) / numThreads;
+                    for (size_t d = first; d < last; d++) {
+                        double length = 0;
+                        for (const pair<int, int>& word : documents[d]) {
+                            if (featureColumn[word.first] >= 0 && word.second > 0) length += word.second;
+                        }
+                        for (int i = 0; i < numClasses; i++) {
+                            for (int b = 0; b < numBetas; b++) {
+                                scores[(size_t) i * numBetas + b] = classProbabilities.at(i) + length * lengthTerms[(size_t) i * numBetas + b];
+                            }
+                        }
+                        for (const pair<int, int>& word : documents[d]) {
+                            int column = featureColumn[word.first];
+                            if (column < 0) continue;
+                            for (int cell = columnStart[column]; cell < columnStart[column + 1]; cell++) {
+                                double * classScores = &scores[(size_t) cellClass[cell] * numBetas];
+                                const double * gains = &cellGains[(size_t) cell * numBetas];
+                                for (int b = 0; b < numBetas; b++) {
+                                    classScores[b] += word.second * gains[b];
+                                }
+                            }
+                        }
+                        for (int b = 0; b < numBetas; b++) {
+                            int best = 0;
+                            for (int i = 1; i < numClasses; i++) {
+                                if (scores[(size_t) i * numBetas + b] > scores[(size_t) best * numBetas + b]) best = i;
+                            }
+                            if (best + 1 == labels[d]) threadCorrect[t][b] += 1;
+                        }
+                    }
+                }));
+            }
+            for (thread& worker : workers) {
+                worker.join();
+            }
+            end = chrono::steady_clock::now();
+            std::cout << "Time to predict classes under every beta = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms] over " << numThreads << " threads" << std::endl;
+            profileCount("nb_documents_scored", (long long) documents.size() * numBetas);
+
+            double total = (double) documents.size();
+            int bestBeta = 0;
+            vector<double> correct(numBetas, 0.0);
+            for (int b = 0; b < numBetas; b++) {
+                for (int t = 0; t < numThreads; t++) {
+                    correct[b] += threadCorrect[t][b];
+                }
+                if (correct[b] > correct[bestBeta]) bestBeta = b;
+            }
+            ofstream record;
+            record.open("last_run_info.txt");
+            record << "Total: " << total << endl;
+            for (int b = 0; b < numBetas; b++) {
+                std::cout << "Beta " << smoothing[b] << ": " << (correct[b]/total) * 100 << "%" << std::endl;
+                record << "Beta: " << smoothing[b] << " Correct: " << correct[b] << " Accuracy: " << (correct[b]/total) * 100 << "%" << endl;
+            }
+            record << "Best beta: " << smoothing[bestBeta] << endl;
+            record.close();
+        }
+
+        int predict(const sparseDocument& document) {
+            if (pruningGains.size() > 0) return predictPruned(document);
+            return predictFull(document);
+        }
+
+        // Score every class, whether pruning is enabled or not
+        int predictFull(const sparseDocument& document) {
+            return argmaxClass(logScores(document));
+        }
+
+        // Make predict eliminate classes that can no longer win instead of scoring all of them. Costs one
+        // double per class and feature column, online updates keep the table and its bounds valid.
+        void enablePruning() {
+            scopedTimer timer("nb_enable_pruning");
+            pruningGains = MatrixXd::Zero(countMatrix.size(), featureMask.size());
+            for (int j = 0; j < wordLogCounts.size(); j++) {
+                for (const pair<int, double>& entry : wordLogCounts[j]) {
+                    pruningGains(entry.first, j) = entry.second;
+                }
+            }
+            columnBounds(pruningGains, pruningUpper, pruningLower);
+        }
+
+        // Same class as the full scorer, words are applied by decreasing gain spread until one class is left
+        int predictPruned(const sparseDocument& document) {
+            double length = 0;
+            vector<pair<int, double>> terms;
+            for (const pair<int, int>& word : document) {
+                int column = featureColumn[word.first];
+                if (column >= 0) {
+                    length += word.second;
+                    terms.push_back(make_pair(column, (double) word.second));
+                }
+            }
+            vector<double> scores = baseScores(length);
+            return prunedArgmax(pruningGains, pruningUpper, pruningLower, scores, terms) + 1;
+        }
+
+        // Posterior probability of every class for a document, the scores are log2 so they are normalized in base 2
+        vector<double> posterior(const sparseDocument& document) {
+            vector<double> scores = logScores(document);
+            double maxScore = *max_element(scores.begin(), scores.end());
+            double total = 0.0;
+            for (double& score : scores) {
+                score = exp2(score - maxScore);
+                total += score;
+            }
+            for (double& score : scores) {
+                score /= total;
+            }
+            return scores;
         }
-        
 
     private:
+        // Set the smoothing factor and derive the model from the loaded counts
+        void train(double b, int vocabularySize, bool verbose = true) {
+            if (b > 0) {
+                beta = b;
+                alpha = 1 + b;
+            } else {
+                beta = (1.0/(double) vocabularySize);
+                alpha = 1 + beta;
+            }
+            if (verbose) cout << "Alpha: " << alpha << endl;
+
+            numberOfDcuments = 0;   // Sum of class representations
+
+            // Calculate number of documents
+            for (int i : classRepresentation) {
+                numberOfDcuments = numberOfDcuments + i;
+            }
+
+            fillClassProbabilities();
+            fillProbabilityMatrix(verbose);
+        }
+
+        // Keep the counts of every class in the narrowest width that holds them
+        void storeCounts(const vector<vector<int>>& counts) {
+            countMatrix.clear();
+            for (const vector<int>& row : counts) {
+                countMatrix.push_back(compactCountRow(row));
+            }
+        }
+
+        // Refresh the smoothed log count of one cell after its count changed
+        void refreshCell(int i, int j) {
+            vector<pair<int, double>>& column = wordLogCounts.at(j);
+            double gain = log2(countMatrix.at(i).at(j) + (alpha - 1)) - logBeta;
+            quantStale = quantBits > 0;
+            // Counts only grow, so raising the upper bound keeps both bounds valid
+            if (pruningGains.size() > 0) {
+                pruningGains(i, j) = gain;
+                pruningUpper[j] = max(pruningUpper[j], gain);
+            }
+            for (pair<int, double>& entry : column) {
+                if (entry.first == i) {
+                    entry.second = gain;
+                    return;
+                }
+            }
+            column.push_back(make_pair(i, gain));
+        }
+
+        // Refresh the log denominator of one class after its word total changed, O(1) whatever the vocabulary size
+        void refreshDenominator(int i) {
+            logDenominator.at(i) = log2((double) rawCount.at(i) + ((alpha - 1) * featureMask.size()));
+        }
+
+        sparseDocument readDocument(const string& path, const perfectHashVocabulary& lookup) {
+            if (hashBits > 0) return hashFile(path, hashBits, false);
+            return tokenizeFile(path, lookup);
+        }
+
         void fillClassProbabilities() {
             for (int i = 0; i < classRepresentation.size(); i++){
                 classProbabilities[i] = log2(((double) classRepresentation.at(i) / (double) numberOfDcuments));
             }
+            priorsStale = false;
         }
 
-        void fillProbabilityMatrix() {
-            // I assume i refers to the class index here
+        void fillProbabilityMatrix(bool verbose = true) {
+            scopedTimer timer("nb_fill");
+            logBeta = log2(alpha - 1);
+            logDenominator.assign(countMatrix.size(), 0.0);
+            wordLogCounts.assign(featureMask.size(), vector<pair<int, double>>());
+            int nonzeros = 0;
+            size_t storedBytes = 0;
+            vector<int> counts(featureMask.size());
             for (int i = 0; i < countMatrix.size(); i++) {
-                for (int j = 0; j < countMatrix.at(i).size(); j++) {
-                    probMatrix.at(i).at(j) = (countMatrix.at(i).at(j) + (alpha - 1)) / ((double) rawCount.at(i) + ((alpha - 1) * vocab.size()));
-                    if(probMatrix.at(i).at(j) <= 0){
-                        cout << "prob is: " << probMatrix.at(i).at(j) << endl;
+                refreshDenominator(i);
+                countMatrix.at(i).decode(counts.data());
+                storedBytes += countMatrix.at(i).bytes();
+                for (int j = 0; j < counts.size(); j++) {
+                    if (counts[j] != 0) {
+                        refreshCell(i, j);
+                        nonzeros++;
                     }
-                    probMatrix.at(i).at(j) = log2(probMatrix.at(i).at(j));
                 }
             }
-            cout << "Length of outer vector: " << probMatrix.size() << endl;
-            cout << "Length of inner vector: " << probMatrix.at(0).size() << endl;
-            ofstream file;
-            file.open("probMatrix.mtx");
-            writeDoubleMatrixToFile(probMatrix, file);
-            file.close();
+            if (verbose) {
+                cout << "Nonzero counts: " << nonzeros << " of " << countMatrix.size() * featureMask.size() << endl;
+                cout << "Count storage: " << storedBytes / 1024 << " KB, " << countMatrix.size() * featureMask.size() * sizeof(int) / 1024 << " KB as int" << endl;
+            }
+            profileCount("nb_model_nonzeros", nonzeros);
         }
 
-        int predict(vector<int> features) {
-            int maxIndex = 0;
-            double maxVal = 0;
+        // Scores of every class for a document of the given length before any word evidence,
+        // as if every word had a zero count in every class
+        vector<double> baseScores(double length) {
+            if (priorsStale) fillClassProbabilities();
+            vector<double> scores(classRepresentation.size());
+            for (int i = 0; i < scores.size(); i++) {
+                scores[i] = classProbabilities.at(i) + length * (logBeta - logDenominator[i]);
+            }
+            return scores;
+        }
+
+        int argmaxClass(const vector<double>& scores) {
+            return (int) (max_element(scores.begin(), scores.end()) - scores.begin()) + 1;
+        }
+
+        int predict(const vector<int>& features) {
+            // Every counted word pays the class denominator and the zero count term once
+            double length = 0;
+            for (int j = 0; j < featureMask.size(); j++) {
+                int count = features.at(featureMask[j]);
+                if (count > 0) length += count;
+            }
+
+            vector<double> scores = baseScores(length);
+            for (int j = 0; j < featureMask.size(); j++) {
+                int count = features.at(featureMask[j]);
+                if (count > 0) {
+                    for (const pair<int, double>& entry : wordLogCounts[j]) {
+                        scores[entry.first] += count * entry.second;
+                    }
+                }
+            }
+            return argmaxClass(scores);
+        }
+
+        // Unnormalized log2 posterior of every class
+        vector<double> logScores(const sparseDocument& document) {
+            profileCount("nb_documents_scored", 1);
+            profileCount("nb_document_nonzeros", (long long) document.size());
+            double length = 0;
+            for (const pair<int, int>& word : document) {
+                if (featureColumn[word.first] >= 0) length += word.second;
+            }
 
-            for (int i = 0; i < features.size(); i++) {
-                if (countMatrix.at(0).at(i) > 0) {
-                    maxVal = maxVal + (countMatrix.at(0).at(i)  * probMatrix.at(0).at(i));
+            vector<double> scores = baseScores(length);
+            for (const pair<int, int>& word : document) {
+                int column = featureColumn[word.first];
+                if (column >= 0) {
+                    for (const pair<int, double>& entry : wordLogCounts[column]) {
+                        scores[entry.first] += word.second * entry.second;
+                    }
                 }
             }
-            
-            double currVal;
-            for (int i = 1; i < classRepresentation.size(); i++) {
-                currVal = classProbabilities[i];
+            return scores;
+        }
+
+        // Quantized tables of the current gains in quantBits entries
+        void buildQuantizedTables() {
+            int numClasses = (int) countMatrix.size();
+            int numColumns = (int) featureMask.size();
 
-                for (int j = 0; j < features.size(); j++) {
-                    if (features.at(j) > 0) {
-                        currVal = currVal + (((double) features.at(j))  * probMatrix.at(i).at(j));
+            if (quantBits == 16) {
+                // One scale per class: the largest gain of the class maps to the largest int16
+                VectorXd maxGain = VectorXd::Zero(numClasses);
+                for (int j = 0; j < numColumns; j++) {
+                    for (const pair<int, double>& entry : wordLogCounts[j]) {
+                        maxGain[entry.first] = max(maxGain[entry.first], entry.second);
+                    }
+                }
+                quantStep = maxGain / 32767.0;
+                quantTable16 = Matrix<int16_t, Dynamic, Dynamic>::Zero(numClasses, numColumns);
+                for (int j = 0; j < numColumns; j++) {
+                    for (const pair<int, double>& entry : wordLogCounts[j]) {
+                        quantTable16(entry.first, j) = (int16_t) lround(entry.second / quantStep[entry.first]);
+                    }
+                }
+            } else {
+                // One scale per feature column, so rare words keep their resolution next to frequent ones. The
+                // scale of column j is the shared step times 2^quantShift[j], at most 2^maxShift, and counts are
+                // shifted by it so every product accumulates as an integer.
+                const int maxShift = 16;
+                VectorXd columnMax = VectorXd::Zero(numColumns);
+                for (int j = 0; j < numColumns; j++) {
+                    for (const pair<int, double>& entry : wordLogCounts[j]) {
+                        columnMax[j] = max(columnMax[j], entry.second);
                     }
                 }
-                if (currVal > maxVal) {
-                    maxVal = currVal;
-                    maxIndex = i;
+                double step = columnMax.maxCoeff() / 127.0 / (1 << maxShift);
+                quantStep = VectorXd::Constant(1, step);
+                quantShift.assign(numColumns, 0);
+                quantTable8 = Matrix<int8_t, Dynamic, Dynamic>::Zero(numClasses, numColumns);
+                for (int j = 0; j < numColumns; j++) {
+                    // Smallest shift whose scale still fits the largest gain of the column into 127 steps
+                    while (quantShift[j] < maxShift && columnMax[j] > 127.0 * step * (1 << quantShift[j])) quantShift[j]++;
+                    double columnStep = step * (1 << quantShift[j]);
+                    for (const pair<int, double>& entry : wordLogCounts[j]) {
+                        quantTable8(entry.first, j) = (int8_t) max(-127L, min(127L, lround(entry.second / columnStep)));
+                    }
                 }
             }
-            return maxIndex + 1;
+            quantStale = false;
+        }
+
+        // Same score as predict with the quantized gains. Both widths accumulate count * entry in int64 lanes per
+        // class, int8 counts are first shifted by the scale of their column. Not safe to call concurrently
+        // with updates, the tables are rebuilt here after the model changed.
+        int predictQuantized(const sparseDocument& document) {
+            if (quantStale) buildQuantizedTables();
+            double length = 0;
+            for (const pair<int, int>& word : document) {
+                if (featureColumn[word.first] >= 0) length += word.second;
+            }
+
+            vector<double> scores = baseScores(length);
+            int numClasses = (int) scores.size();
+            Matrix<int64_t, Dynamic, 1> accumulator = Matrix<int64_t, Dynamic, 1>::Zero(numClasses);
+            if (quantBits == 16) {
+                for (const pair<int, int>& word : document) {
+                    int column = featureColumn[word.first];
+                    if (column >= 0) accumulator += (int64_t) word.second * quantTable16.col(column).cast<int64_t>();
+                }
+                for (int i = 0; i < numClasses; i++) {
+                    scores[i] += accumulator[i] * quantStep[i];
+                }
+            } else {
+                for (const pair<int, int>& word : document) {
+                    int column = featureColumn[word.first];
+                    if (column >= 0) accumulator += ((int64_t) word.second << quantShift[column]) * quantTable8.col(column).cast<int64_t>();
+                }
+                for (int i = 0; i < numClasses; i++) {
+                    scores[i] += accumulator[i] * quantStep[0];
+                }
+            }
+            return argmaxClass(scores);
         }
 
         
 };
 
+// Word presence bitset of a document over the vocabulary, bit j of word j / 64 is set when word j occurs
+typedef vector<uint64_t> packedDocument;
+
+packedDocument packDocument(const sparseDocument& document, int vocabularySize) {
+    packedDocument bits((vocabularySize + 63) / 64, 0);
+    for (const pair<int, int>& word : document) {
+        if (word.second > 0) bits[word.first >> 6] |= (uint64_t) 1 << (word.first & 63);
+    }
+    return bits;
+}
+
+// Bernoulli event model: a document is the set of words it contains, and every word of the vocabulary
+// is an independent present or absent trial per class. Scoring starts from the score of a document with
+// every word absent and corrects it for the set bits only, so a document costs O(words present).
+class bernoulliNaiveBayes {
+
+    public:
+        // List of words
+        vector<string> vocab;
+
+        // List of classes
+        vector<string> label_vocab;
+
+        // Number of training documents of each class that contain a word
+        vector<vector<int>> docFreqMatrix;
+
+        // Vector containing total representation for each class
+        vector<int> classRepresentation;
+
+        // Beta smoothing factor
+        double beta;
+
+        // log2 prior plus the sum of log2(1 - theta) over the vocabulary, per class
+        vector<double> absentScores;
+
+        // log2(theta) - log2(1 - theta) of word j and class i at j * numClasses + i, one cache line per few words
+        vector<double> presentGains;
+
+        bernoulliNaiveBayes(string file, string vocab_file, string labels_file, double b) {
+            scopedTimer timer("nb_bernoulli_construct");
+            docFreqMatrix = read_csv_int(file);
+            vocab = read_lines(vocab_file);
+            label_vocab = read_lines(labels_file);
+            classRepresentation = read_vec_int("classRepresentation.vec");
+            train(b);
+        }
+
+        int predict(const packedDocument& bits) {
+            int numClasses = (int) absentScores.size();
+            vector<double> scores = absentScores;
+            for (int w = 0; w < bits.size(); w++) {
+                uint64_t word = bits[w];
+                while (word != 0) {
+                    int j = (w << 6) + __builtin_ctzll(word);
+                    word &= word - 1;
+                    const double * gains = &presentGains[(size_t) j * numClasses];
+                    for (int i = 0; i < numClasses; i++) {
+                        scores[i] += gains[i];
+                    }
+                }
+            }
+            return (int) (max_element(scores.begin(), scores.end()) - scores.begin()) + 1;
+        }
+
+        // Same score for a sparse document, only whether a count is nonzero matters
+        int predict(const sparseDocument& document) {
+            int numClasses = (int) absentScores.size();
+            vector<double> scores = absentScores;
+            for (const pair<int, int>& word : document) {
+                if (word.second <= 0) continue;
+                const double * gains = &presentGains[(size_t) word.first * numClasses];
+                for (int i = 0; i < numClasses; i++) {
+                    scores[i] += gains[i];
+                }
+            }
+            return (int) (max_element(scores.begin(), scores.end()) - scores.begin()) + 1;
+        }
+
+        // Load a count file as packed bitsets, then score it. Files with a column after the vocabulary
+        // are labelled and counted into last_run_info.txt, others are written to submission.csv.
+        void testModel(string file) {
+            scopedTimer timer("nb_bernoulli_test_model");
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            int numWords = (int) vocab.size();
+            vector<sparseDocument> sparseDocuments;
+            vector<int> ids;
+            vector<int> labels;
+            bool labelled = readSparseCsv(file, numWords, sparseDocuments, ids, labels);
+            vector<packedDocument> documents;
+            for (sparseDocument& document : sparseDocuments) {
+                documents.push_back(packDocument(document, numWords));
+                sparseDocument().swap(document);
+            }
+            chrono::steady_clock::time_point end = chrono::steady_clock::now();
+            std::cout << "Time to read and pack " << documents.size() << " documents = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms], "
+                      << documents.size() * ((numWords + 63) / 64) * sizeof(uint64_t) / 1024 << " KB of bitsets" << std::endl;
+
+            begin = chrono::steady_clock::now();
+            vector<int> predictions(documents.size());
+            for (int i = 0; i < documents.size(); i++) {
+                predictions[i] = predict(documents[i]);
+            }
+            end = chrono::steady_clock::now();
+            std::cout << "Time to predict classes = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+            profileCount("nb_bernoulli_documents_scored", (long long) documents.size());
+
+            if (labelled) {
+                double correct = 0.0;
+                double total = (double) documents.size();
+                for (int i = 0; i < documents.size(); i++) {
+                    if (predictions[i] == labels[i]) correct = correct + 1.0;
+                }
+                ofstream record;
+                record.open("last_run_info.txt");
+                record << "Total: " << total << endl << "Correct: " << correct << endl << "Accuracy: " << (correct/total) * 100 << "%" << endl;
+                record.close();
+            } else {
+                ofstream submission;
+                submission.open("submission.csv");
+                submission << "id,class" << endl;
+                for (int i = 0; i < documents.size(); i++) {
+                    submission << ids[i] << "," << predictions[i] << "\n";
+                }
+                submission.close();
+            }
+        }
+
+    private:
+        // theta of word j in class i = (docFreq + beta) / (classDocuments + 2 * beta). As in NaiveBayes::train,
+        // beta <= 0 means 1 / |V|, which keeps theta inside (0, 1): a word seen in none or all of the documents
+        // of a class and a class without documents (theta 1/2) all stay finite. Only the log prior of an
+        // empty class is -inf, so it is never predicted, as in the multinomial model.
+        void train(double b) {
+            int numClasses = (int) docFreqMatrix.size();
+            int numWords = (int) vocab.size();
+            beta = b > 0 ? b : 1.0 / (double) numWords;
+            int numberOfDocuments = 0;
+            for (int count : classRepresentation) {
+                numberOfDocuments += count;
+            }
+
+            absentScores.assign(numClasses, 0.0);
+            presentGains.assign((size_t) numWords * numClasses, 0.0);
+            for (int i = 0; i < numClasses; i++) {
+                double denominator = classRepresentation.at(i) + 2 * beta;
+                double absent = log2((double) classRepresentation.at(i) / (double) numberOfDocuments);
+                for (int j = 0; j < numWords; j++) {
+                    double theta = (docFreqMatrix.at(i).at(j) + beta) / denominator;
+                    double logAbsent = log2(1.0 - theta);
+                    absent += logAbsent;
+                    presentGains[(size_t) j * numClasses + i] = log2(theta) - logAbsent;
+                }
+                absentScores[i] = absent;
+            }
+        }
+};
+
+// K-fold cross-validation on a labelled count file. Every document is assigned to one of K folds, the word
+// and document counts of each fold are aggregated once, in parallel, and summed into the corpus totals. The
+// model of fold f is then built from (total - fold f) counts without reading the corpus again, and every fold
+// model scores its held-out documents concurrently. Writes the accuracy over all folds and per fold to last_run_info.txt.
+void crossValidateNaiveBayes(string file, string vocab_file, string labels_file, int numFolds, double b, int numThreads) {
+    scopedTimer timer("nb_cross_validation");
+    if (numFolds < 2) throw runtime_error("Cross-validation needs at least 2 folds");
+    vector<string> vocab = read_lines(vocab_file);
+    vector<string> label_vocab = read_lines(labels_file);
+    int numWords = (int) vocab.size();
+    int numClasses = (int) label_vocab.size();
+    if (numThreads <= 0) numThreads = max(1, (int) thread::hardware_concurrency());
+    numThreads = min(numThreads, numFolds);
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    vector<sparseDocument> parsed;
+    vector<int> ids;
+    vector<int> labels;
+    if (!readSparseCsv(file, numWords, parsed, ids, labels)) throw runtime_error("Cross-validation needs a labelled file");
+    // Every fold has to hold out at least one document, or its accuracy is 0/0
+    if (numFolds > parsed.size()) throw runtime_error("Cannot split " + to_string(parsed.size()) + " documents into " + to_string(numFolds) + " folds");
+    // Labels are checked here, an exception on a fold thread would terminate the process
+    for (int d = 0; d < labels.size(); d++) {
+        if (labels[d] < 1 || labels[d] > numClasses) {
+            throw runtime_error("Label " + to_string(labels[d]) + " of document " + to_string(ids[d]) + " is not a class of " + labels_file);
+        }
+    }
+
+    // The corpus stays in memory for both passes, as varints
+    vector<compactDocument> documents;
+    size_t storedBytes = 0;
+    for (sparseDocument& document : parsed) {
+        documents.push_back(compactDocument(document));
+        storedBytes += documents.back().bytes();
+        sparseDocument().swap(document);
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Time to read " << documents.size() << " documents = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms], "
+              << storedBytes / 1024 << " KB stored" << std::endl;
+
+    // Folds over a fixed shuffle, so rows sorted by class still give balanced folds
+    vector<vector<int>> foldDocuments(numFolds);
+    vector<int> order(documents.size());
+    for (int d = 0; d < order.size(); d++) {
+        order[d] = d;
+    }
+    mt19937 rng(7);
+    shuffle(order.begin(), order.end(), rng);
+    for (int d = 0; d < order.size(); d++) {
+        foldDocuments[d % numFolds].push_back(order[d]);
+    }
+
+    // One pass over the corpus: each fold aggregates only its own documents
+    begin = chrono::steady_clock::now();
+    vector<vector<vector<int>>> foldCounts(numFolds, vector<vector<int>>(numClasses, vector<int>(numWords, 0)));
+    vector<vector<int>> foldClassCounts(numFolds, vector<int>(numClasses, 0));
+    vector<thread> workers;
+    for (int t = 0; t < numThreads; t++) {
+        workers.push_back(thread([&, t]() {
+            sparseDocument document;
+            for (int f = t; f < numFolds; f += numThreads) {
+                for (int d : foldDocuments[f]) {
+                    int _class = labels[d] - 1;
+                    foldClassCounts[f].at(_class) += 1;
+                    vector<int>& counts = foldCounts[f].at(_class);
+                    documents[d].decode(document);
+                    for (const pair<int, int>& word : document) {
+                        counts[word.first] += word.second;
+                    }
+                }
+            }
+        }));
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    vector<vector<int>> totalCounts(numClasses, vector<int>(numWords, 0));
+    vector<int> totalClassCounts(numClasses, 0);
+    for (int f = 0; f < numFolds; f++) {
+        for (int i = 0; i < numClasses; i++) {
+            totalClassCounts[i] += foldClassCounts[f][i];
+            for (int j = 0; j < numWords; j++) {
+                totalCounts[i][j] += foldCounts[f][i][j];
+            }
+        }
+    }
+    end = chrono::steady_clock::now();
+    std::cout << "Time to aggregate " << numFolds << " folds = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    // Fold f trains on total - fold f and scores fold f. A fold table is reused in place for its complement.
+    begin = chrono::steady_clock::now();
+    vector<int> foldCorrect(numFolds, 0);
+    for (int t = 0; t < numThreads; t++) {
+        workers.push_back(thread([&, t]() {
+            for (int f = t; f < numFolds; f += numThreads) {
+                vector<vector<int>>& counts = foldCounts[f];
+                vector<int>& classCounts = foldClassCounts[f];
+                for (int i = 0; i < numClasses; i++) {
+                    classCounts[i] = totalClassCounts[i] - classCounts[i];
+                    for (int j = 0; j < numWords; j++) {
+                        counts[i][j] = totalCounts[i][j] - counts[i][j];
+                    }
+                }
+                NaiveBayes model(counts, classCounts, vocab, label_vocab, b, false);
+                vector<vector<int>>().swap(counts);
+                sparseDocument document;
+                for (int d : foldDocuments[f]) {
+                    documents[d].decode(document);
+                    if (model.predict(document) == labels[d]) foldCorrect[f] += 1;
+                }
+            }
+        }));
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    end = chrono::steady_clock::now();
+    std::cout << "Time to train and score " << numFolds << " folds = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms] over " << numThreads << " threads" << std::endl;
+
+    double correct = 0.0;
+    double total = (double) documents.size();
+    for (int f = 0; f < numFolds; f++) {
+        correct += foldCorrect[f];
+    }
+    ofstream record;
+    record.open("last_run_info.txt");
+    record << "Total: " << total << endl << "Correct: " << correct << endl << "Accuracy: " << (correct/total) * 100 << "%" << endl;
+    for (int f = 0; f < numFolds; f++) {
+        double foldAccuracy = (double) foldCorrect[f] / (double) foldDocuments[f].size();
+        std::cout << "Fold " << f + 1 << ": " << foldAccuracy * 100 << "%" << std::endl;
+        record << "Fold: " << f + 1 << " Total: " << foldDocuments[f].size() << " Correct: " << foldCorrect[f] << " Accuracy: " << foldAccuracy * 100 << "%" << endl;
+    }
+    record.close();
+    std::cout << "Cross-validated accuracy = " << (correct/total) * 100 << "%" << std::endl;
+}
+
 int runNB(int argc, char** argv) {
     if(argc < 7){
-        cerr << "Usage: " << argv[0] << " <countMatrix.mtx> <vocab.txt> <labels.txt> <testFile.csv> <betaValue>" << endl;
+        cerr << "Usage: " << argv[0] << " <countMatrix.mtx> <vocab.txt> <labels.txt> <testFile.csv> <betaValue> [featureMask.vec]" << endl;
         return 0;
     }
+    vector<int> featureMask;
+    if (argc > 7) {
+        featureMask = read_vec_int(argv[7]);
+    }
     chrono::steady_clock::time_point begin = chrono::steady_clock::now();
-    NaiveBayes test(argv[2], argv[3], argv[4], atof(argv[6]));
+    NaiveBayes test(argv[2], argv[3], argv[4], atof(argv[6]), featureMask);
 
     chrono::steady_clock::time_point end = chrono::steady_clock::now();
     std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
@@ -214,6 +1145,141 @@ int runNB(int argc, char** argv) {
     test.testModel(argv[5], true);
 
     end = chrono::steady_clock::now();
-    std::cout << "Total time for reading and predicting = " << std::chrono::duration_cast<std::chrono::seconds>(end - begin).count() << "[s]" << std::endl;
+    std::cout << "Total time for reading and predicting = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+    return 0;
+}
+
+int runNBText(int argc, char** argv) {
+    if(argc < 7){
+        cerr << "Usage: " << argv[0] << " nbtext <countMatrix.mtx> <vocab.txt> <labels.txt> <documentList.txt> <betaValue> [featureMask.vec]" << endl;
+        return 0;
+    }
+    vector<int> featureMask;
+    if (argc > 7) {
+        featureMask = read_vec_int(argv[7]);
+    }
+    NaiveBayes model(argv[2], argv[3], argv[4], atof(argv[6]), featureMask);
+
+    // Score against labels when the list carries them, otherwise write a submission file
+    vector<vector<string>> documents = read_csv(argv[5]);
+    model.testDocuments(argv[5], documents.empty() || documents.at(0).size() < 2);
+    return 0;
+}
+
+int runNBHash(int argc, char** argv) {
+    if(argc < 7){
+        cerr << "Usage: " << argv[0] << " nbhash <trainList.txt> <labels.txt> <documentList.txt> <bits> <betaValue>" << endl;
+        return 0;
+    }
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    NaiveBayes model(argv[2], argv[3], atoi(argv[5]), atof(argv[6]));
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    vector<vector<string>> documents = read_csv(argv[4]);
+    model.testDocuments(argv[4], documents.empty() || documents.at(0).size() < 2);
+    return 0;
+}
+
+int runNBStream(int argc, char** argv) {
+    if(argc < 7){
+        cerr << "Usage: " << argv[0] << " nbstream <countMatrix.mtx> <vocab.txt> <labels.txt> <labelledStream.csv> <betaValue>" << endl;
+        return 0;
+    }
+    NaiveBayes model(argv[2], argv[3], argv[4], atof(argv[6]));
+    model.testThenTrain(argv[5]);
+    return 0;
+}
+
+int runNBQuant(int argc, char** argv) {
+    if(argc < 8){
+        cerr << "Usage: " << argv[0] << " nbquant <countMatrix.mtx> <vocab.txt> <labels.txt> <labelledTest.csv> <betaValue> <8|16>" << endl;
+        return 0;
+    }
+    NaiveBayes model(argv[2], argv[3], argv[4], atof(argv[6]));
+    model.quantize(atoi(argv[7]));
+    model.compareQuantized(argv[5]);
+    return 0;
+}
+
+int runNBSweep(int argc, char** argv) {
+    if(argc < 7){
+        cerr << "Usage: " << argv[0] << " nbsweep <countMatrix.mtx> <vocab.txt> <labels.txt> <labelledTest.csv> <beta,beta,...> [numThreads]" << endl;
+        return 0;
+    }
+    vector<double> betas;
+    stringstream list(argv[6]);
+    string value;
+    while (getline(list, value, ',')) {
+        if (!value.empty()) betas.push_back(stod(value));
+    }
+    if (betas.empty()) throw runtime_error("No betas to sweep");
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    NaiveBayes model(argv[2], argv[3], argv[4], betas.at(0));
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    begin = chrono::steady_clock::now();
+    model.sweepBetas(betas, argv[5], argc > 7 ? atoi(argv[7]) : 0);
+    end = chrono::steady_clock::now();
+    std::cout << "Total time for reading and predicting = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+    return 0;
+}
+
+int runNBCrossValidation(int argc, char** argv) {
+    if(argc < 7){
+        cerr << "Usage: " << argv[0] << " nbcv <training.csv> <vocab.txt> <labels.txt> <numFolds> <betaValue> [numThreads]" << endl;
+        return 0;
+    }
+    if(atoi(argv[5]) < 2){
+        cerr << "Usage: " << argv[0] << " nbcv <training.csv> <vocab.txt> <labels.txt> <numFolds> <betaValue> [numThreads]" << endl;
+        cerr << "<numFolds> must be at least 2 and at most the number of documents" << endl;
+        return 0;
+    }
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    crossValidateNaiveBayes(argv[2], argv[3], argv[4], atoi(argv[5]), atof(argv[6]), argc > 7 ? atoi(argv[7]) : 0);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Total time for cross-validation = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+    return 0;
+}
+
+int runNBPrune(int argc, char** argv) {
+    if(argc < 7){
+        cerr << "Usage: " << argv[0] << " nbprune <countMatrix.mtx> <vocab.txt> <labels.txt> <labelledTest.csv> <betaValue>" << endl;
+        return 0;
+    }
+    NaiveBayes model(argv[2], argv[3], argv[4], atof(argv[6]));
+    model.enablePruning();
+    comparePrunedScoring(argv[5], (int) model.featureColumn.size(),
+                         [&model](const sparseDocument& document) { return model.predictFull(document); },
+                         [&model](const sparseDocument& document) { return model.predictPruned(document); });
+    return 0;
+}
+
+int runNBServe(int argc, char** argv) {
+    if(argc < 7){
+        cerr << "Usage: " << argv[0] << " nbserve <countMatrix.mtx> <vocab.txt> <labels.txt> <betaValue> <socketPath> [numThreads]" << endl;
+        return 0;
+    }
+    NaiveBayes model(argv[2], argv[3], argv[4], atof(argv[5]));
+    // predict and posterior only read the model from here on
+    serveModel(argv[6], argc > 7 ? atoi(argv[7]) : 0, (int) model.featureColumn.size(), (int) model.label_vocab.size(),
+               [&model](const sparseDocument& document) { return model.predict(document); },
+               [&model](const sparseDocument& document) { return model.posterior(document); });
+    return 0;
+}
+
+int runNBBernoulli(int argc, char** argv) {
+    if(argc < 7){
+        cerr << "Usage: " << argv[0] << " nbbernoulli <wordToClassDocFreq.mtx> <vocab.txt> <labels.txt> <testFile.csv> <betaValue>" << endl;
+        return 0;
+    }
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    bernoulliNaiveBayes model(argv[2], argv[3], argv[4], atof(argv[6]));
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    model.testModel(argv[5]);
     return 0;
-}
\ No newline at end of file
+}
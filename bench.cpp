@@ -0,0 +1,282 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <utility> // pair
+#include <functional>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "pythonpp.h"
+#include "NaiveBayesClassifier.h"
+#include "logisticRegressionClassifier.h"
+#include "synthetic.h"
+#include <bench/BenchTimer.h>
+
+using namespace std;
+
+// Timings of one benchmark. Times are wall clock seconds of a whole try, a try runs the code reps times.
+struct benchResult {
+    string name;
+    int tries;
+    int reps;
+    double best;
+    double worst;
+    double total;
+    double items; // Documents, rows or splits processed per rep
+    double bytes; // Input bytes processed per rep, 0 when not meaningful
+};
+
+static vector<benchResult> results;
+
+// Copies made and peak RSS growth when a labelled test file is loaded and split into rows and labels
+struct copyResult {
+    string name;
+    double copiedBytes;
+    long peakRssGrowthKb;
+};
+
+static vector<copyResult> copyResults;
+
+// Keeps benchmarked results alive so the compiler cannot drop the work
+static volatile long sink;
+
+static void record(const string& name, const BenchTimer& timer, int tries, int reps, double items, double bytes) {
+    benchResult result = {name, tries, reps, timer.best(REAL_TIMER), timer.worst(REAL_TIMER), timer.total(REAL_TIMER), items, bytes};
+    results.push_back(result);
+    double perRep = result.best / reps;
+    cout << name << ": " << perRep * 1e3 << "[ms]";
+    if (items > 0) cout << ", " << items / perRep << " items/s";
+    if (bytes > 0) cout << ", " << bytes / perRep / 1e6 << " MB/s";
+    cout << endl;
+}
+
+static void writeJson(const string& filename, const syntheticCorpusConfig& config) {
+    ofstream file;
+    file.open(filename);
+    file << "{" << endl;
+    file << "  \"config\": {\"documents\": " << config.numDocuments << ", \"vocabulary\": " << config.vocabularySize
+         << ", \"classes\": " << config.numClasses << ", \"density\": " << config.density << ", \"seed\": " << config.seed << "}," << endl;
+    file << "  \"benchmarks\": [" << endl;
+    for (int i = 0; i < results.size(); i++) {
+        const benchResult& r = results[i];
+        double perRep = r.best / r.reps;
+        file << "    {\"name\": \"" << r.name << "\", \"tries\": " << r.tries << ", \"reps\": " << r.reps
+             << ", \"best_ms\": " << perRep * 1e3 << ", \"worst_ms\": " << r.worst / r.reps * 1e3
+             << ", \"mean_ms\": " << r.total / (r.tries * r.reps) * 1e3
+             << ", \"items_per_second\": " << (r.items > 0 ? r.items / perRep : 0)
+             << ", \"mb_per_second\": " << (r.bytes > 0 ? r.bytes / perRep / 1e6 : 0) << "}"
+             << (i + 1 < results.size() ? "," : "") << endl;
+    }
+    file << "  ]," << endl;
+    file << "  \"copies\": [" << endl;
+    for (int i = 0; i < copyResults.size(); i++) {
+        const copyResult& r = copyResults[i];
+        file << "    {\"name\": \"" << r.name << "\", \"copied_bytes\": " << r.copiedBytes << ", \"peak_rss_growth_kb\": " << r.peakRssGrowthKb << "}"
+             << (i + 1 < copyResults.size() ? "," : "") << endl;
+    }
+    file << "  ]" << endl << "}" << endl;
+    file.close();
+}
+
+// Payload bytes of a dataframe, what one full copy of it moves
+static double frameBytes(const vector<vector<int>>& data) {
+    double bytes = 0;
+    for (const vector<int>& row : data) {
+        bytes += row.size() * sizeof(int);
+    }
+    return bytes;
+}
+
+// seperateTargets as it was declared before it took a const reference: the argument is copied on the way in
+static pair<vector<vector<int>>, vector<int>> seperateTargetsByValue(vector<vector<int>> data, int targetIndex, double& copied) {
+    copied += frameBytes(data);
+    pair<vector<vector<int>>, vector<int>> result = seperateTargets(data, targetIndex);
+    copied += frameBytes(result.first) + result.second.size() * sizeof(int);
+    return result;
+}
+
+// Run work, which returns the bytes it copied, in a child process and record how far it raised the peak RSS.
+// The child starts with the current RSS as its peak, so earlier peaks of the benchmark do not hide the growth.
+static void recordCopies(const string& name, const function<double()>& work) {
+    int fds[2];
+    if (pipe(fds) != 0) throw runtime_error("Could not create pipe");
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        long before = peakRssKb();
+        copyResult result = {"", work(), 0};
+        result.peakRssGrowthKb = peakRssKb() - before;
+        bool sent = write(fds[1], &result.copiedBytes, sizeof(double)) == sizeof(double) &&
+                    write(fds[1], &result.peakRssGrowthKb, sizeof(long)) == sizeof(long);
+        _exit(sent ? 0 : 1);
+    }
+    close(fds[1]);
+    copyResult result = {name, -1, -1};
+    if (read(fds[0], &result.copiedBytes, sizeof(double)) != sizeof(double) ||
+        read(fds[0], &result.peakRssGrowthKb, sizeof(long)) != sizeof(long)) {
+        throw runtime_error("Copy benchmark " + name + " failed");
+    }
+    close(fds[0]);
+    waitpid(child, NULL, 0);
+    copyResults.push_back(result);
+    cout << name << ": " << result.copiedBytes / 1e6 << " MB copied, peak RSS +" << result.peakRssGrowthKb << "[KB]" << endl;
+}
+
+static long fileSize(const string& filename) {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) return 0;
+    return (long) info.st_size;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && (string(argv[1]) == "-h" || string(argv[1]) == "--help")) {
+        cerr << "Usage: " << argv[0] << " [numDocuments] [vocabularySize] [numClasses] [density] [results.json]" << endl;
+        return 0;
+    }
+    syntheticCorpusConfig config;
+    config.numDocuments = argc > 1 ? atoi(argv[1]) : 2000;
+    config.vocabularySize = argc > 2 ? atoi(argv[2]) : 20000;
+    config.numClasses = argc > 3 ? atoi(argv[3]) : 20;
+    config.density = argc > 4 ? atof(argv[4]) : 0.01;
+    config.zipfExponent = 1.0;
+    config.classSkew = 0.0;
+    config.seed = 7;
+    string output = argc > 5 ? argv[5] : "bench.json";
+    if (output[0] != '/') output = "../" + output;
+    const int tries = 3;
+
+    // The classifiers load their inputs from the working directory
+    mkdir("bench_data", 0755);
+    if (chdir("bench_data") != 0) throw runtime_error("Could not enter bench_data");
+
+    syntheticCorpus corpus(config);
+    mt19937 rng(config.seed);
+    vector<vector<int>> train = corpus.rows(config.numDocuments, 1, rng);
+    vector<vector<int>> test = corpus.rows(max(1, config.numDocuments / 4), 12001, rng);
+    write_csv(train, "training.csv");
+    write_csv(test, "customTest.csv");
+    for (vector<int>& row : test) {
+        row.pop_back();
+    }
+    write_csv(test, "testing.csv");
+    ofstream lines;
+    lines.open("vocabulary.txt");
+    for (const string& word : syntheticVocabulary(config.vocabularySize)) lines << word << "\n";
+    lines.close();
+    lines.open("newsgrouplabels.txt");
+    for (const string& label : syntheticLabels(config.numClasses)) lines << label << "\n";
+    lines.close();
+
+    BenchTimer timer;
+
+    // Label split of a test file: the three by-value seperateTargets calls testModel used to make, then the
+    // in-place column strips it makes now
+    recordCopies("label_split_by_value", []() {
+        double copied = 0;
+        vector<vector<int>> rows = read_csv_int("customTest.csv");
+        rows = seperateTargetsByValue(rows, 0, copied).first;
+        vector<int> Y = seperateTargetsByValue(rows, rows.at(0).size() - 1, copied).second;
+        rows = seperateTargetsByValue(rows, rows.at(0).size() - 1, copied).first;
+        sink += Y.size() + rows.size();
+        return copied;
+    });
+    recordCopies("label_split_in_place", []() {
+        vector<vector<int>> rows = read_csv_int("customTest.csv");
+        stripColumn(rows, 0);
+        vector<int> Y = stripColumn(rows, rows.at(0).size() - 1);
+        sink += Y.size() + rows.size();
+        return 0.0;
+    });
+
+    // CSV parsing throughput
+    long trainBytes = fileSize("training.csv");
+    vector<vector<int>> data;
+    BENCH(timer, tries, 1, data = read_csv_int("training.csv"));
+    record("read_csv_int", timer, tries, 1, (double) data.size(), (double) trainBytes);
+
+    // Preprocess aggregation into the model files
+    stripColumn(data, 0);
+    vector<vector<int>> wordToClassCount;
+    vector<vector<int>> wordToClassDocFreq;
+    vector<int> rawCount;
+    vector<int> classRepresentation;
+    BENCH(timer, tries, 1, aggregateClassCounts(data, config.numClasses, config.vocabularySize, wordToClassCount, wordToClassDocFreq, rawCount, classRepresentation));
+    record("aggregate_class_counts", timer, tries, 1, (double) data.size(), 0);
+
+    vector<vector<int>> deltaMatrix(config.numClasses, vector<int>(data.size(), 0));
+    for (int i = 0; i < data.size(); i++) {
+        deltaMatrix.at(data.at(i).back() - 1).at(i) = 1;
+    }
+    ofstream file;
+    file.open("wordToClassCount.mtx");
+    writeIntMatrixToFile(wordToClassCount, file);
+    file.close();
+    file.open("rawCount.vec");
+    writeIntVectorToFile(rawCount, file);
+    file.close();
+    file.open("classRepresentation.vec");
+    writeIntVectorToFile(classRepresentation, file);
+    file.close();
+    file.open("deltaMatrix.mtx");
+    writeIntMatrixToFile(deltaMatrix, file);
+    file.close();
+    file.open("dataMatrix.mtx");
+    writeIntMatrixToFile(data, file);
+    file.close();
+
+    // Naive Bayes: loading and deriving the model, then scoring single documents
+    NaiveBayes * model = NULL;
+    BENCH(timer, tries, 1, delete model; model = new NaiveBayes("wordToClassCount.mtx", "vocabulary.txt", "newsgrouplabels.txt", 0.02));
+    record("nb_fill", timer, tries, 1, 0, (double) fileSize("wordToClassCount.mtx"));
+
+    vector<sparseDocument> documents;
+    for (int i = 0; i < config.numDocuments; i++) {
+        documents.push_back(corpus.document(corpus.drawClass(rng), rng));
+    }
+    BENCH(timer, tries, 1, for (const sparseDocument& document : documents) sink += model->predict(document));
+    record("nb_predict", timer, tries, 1, (double) documents.size(), 0);
+
+    // Batch scoring of a test file through the pipelined driver
+    long testBytes = fileSize("testing.csv");
+    BENCH(timer, tries, 1, model->testModel("testing.csv", true));
+    record("nb_batch_scoring", timer, tries, 1, (double) test.size(), (double) testBytes);
+    delete model;
+
+    // Logistic regression: one gradient step over the whole training matrix per rep
+    logisticRegression lr("dataMatrix.mtx", "vocabulary.txt", "newsgrouplabels.txt", 0.01, 0.01, 1);
+    BENCH(timer, tries, 1, lr.train());
+    record("lr_iteration", timer, tries, 1, (double) data.size(), 0);
+    BENCH(timer, tries, 1, for (const sparseDocument& document : documents) sink += lr.predict(document));
+    record("lr_predict", timer, tries, 1, (double) documents.size(), 0);
+
+    // Tree split statistics on a categorical view of the most frequent words
+    const int numAttributes = min(16, config.vocabularySize);
+    vector<vector<string>> categorical(data.size());
+    for (int i = 0; i < data.size(); i++) {
+        for (int j = 0; j < numAttributes; j++) {
+            categorical[i].push_back(to_string(min(data[i][j], 3)));
+        }
+        categorical[i].push_back(to_string(data[i].back()));
+    }
+    BENCH(timer, tries, 1, sink += getMaxGainIndex(categorical, "entropy", numAttributes));
+    record("tree_max_gain", timer, tries, 1, (double) numAttributes, 0);
+
+    precomputeChiSquaredCritical(3 * (config.numClasses - 1), 0.95);
+    auto testAttributes = [&]() {
+        for (int j = 0; j < numAttributes; j++) {
+            int numValues;
+            int numClasses;
+            vector<int> table = contingencyTable(categorical, j, numAttributes, numValues, numClasses);
+            sink += chiSquaredTest(table, numValues, numClasses, 0.95);
+        }
+    };
+    BENCH(timer, tries, 1, testAttributes());
+    record("tree_chi_squared", timer, tries, 1, (double) numAttributes, 0);
+
+    writeJson(output, config);
+    cout << "Results written to " << output << endl;
+    return 0;
+}
@@ -46,9 +46,9 @@ double chisqr(int Dof, double Cv)
     long double ln_PV;
     ln_PV = log_igf(K, X);
 
-    Gam = approx_gamma(K);
+    Gam = log_gamma(K);
     //Gam = lgammal(K);
-    //Gam = log_gamma(K);
+    //Gam = approx_gamma(K);
 
     ln_PV -= Gam;
     PValue = 1.0 - expl(ln_PV);
@@ -0,0 +1,199 @@
+#include "compactCounts.h"
+#include <algorithm>
+#include <stdexcept> // runtime_error
+
+using namespace std;
+
+compactCountRow::compactCountRow() : length(0), bits(8){
+}
+
+compactCountRow::compactCountRow(const vector<int>& counts){
+    encode(counts);
+}
+
+// Width with the fewest bytes, given the entries that overflow 8 and 16 bits. An overflow entry costs 8 bytes.
+static int chooseWidth(size_t length, size_t over8, size_t over16){
+    size_t bytes8 = length + 8 * over8;
+    size_t bytes16 = 2 * length + 8 * over16;
+    size_t bytes32 = 4 * length;
+    return bytes8 <= bytes16 && bytes8 <= bytes32 ? 8 : (bytes16 <= bytes32 ? 16 : 32);
+}
+
+void compactCountRow::encode(const vector<int>& counts){
+    length = (int) counts.size();
+    size_t over8 = 0;
+    size_t over16 = 0;
+    for(int count : counts){
+        if(count < 0 || count >= 0xFF) over8++;
+        if(count < 0 || count >= 0xFFFF) over16++;
+    }
+    bits = chooseWidth(length, over8, over16);
+
+    narrow8.clear();
+    narrow16.clear();
+    wide.clear();
+    overflow.clear();
+    if(bits == 32){
+        wide.assign(counts.begin(), counts.end());
+        return;
+    }
+    int limit = escape();
+    if(bits == 8) narrow8.resize(length);
+    else narrow16.resize(length);
+    for(int j=0; j<length; j++){
+        int count = counts[j];
+        bool fits = count >= 0 && count < limit;
+        if(!fits) overflow.push_back(make_pair(j, count));
+        if(bits == 8) narrow8[j] = (uint8_t) (fits ? count : limit);
+        else narrow16[j] = (uint16_t) (fits ? count : limit);
+    }
+}
+
+int compactCountRow::escape() const{
+    return bits == 8 ? 0xFF : 0xFFFF;
+}
+
+int compactCountRow::size() const{
+    return length;
+}
+
+int compactCountRow::at(int j) const{
+    if(j < 0 || j >= length) throw out_of_range("compactCountRow index out of range");
+    if(bits == 32) return wide[j];
+    int value = bits == 8 ? narrow8[j] : narrow16[j];
+    if(value != escape()) return value;
+    return lower_bound(overflow.begin(), overflow.end(), make_pair(j, INT32_MIN))->second;
+}
+
+void compactCountRow::add(int j, int delta){
+    int value = at(j) + delta;
+    if(bits == 32){
+        wide[j] = value;
+        return;
+    }
+    int limit = escape();
+    vector<pair<int, int>>::iterator entry = lower_bound(overflow.begin(), overflow.end(), make_pair(j, INT32_MIN));
+    bool stored = entry != overflow.end() && entry->first == j;
+    if(value >= 0 && value < limit){
+        if(stored) overflow.erase(entry);
+        if(bits == 8) narrow8[j] = (uint8_t) value;
+        else narrow16[j] = (uint16_t) value;
+        return;
+    }
+    if(stored) entry->second = value;
+    else overflow.insert(entry, make_pair(j, value));
+    if(bits == 8) narrow8[j] = (uint8_t) limit;
+    else narrow16[j] = (uint16_t) limit;
+    // Re-encode only once encode would pick a wider row, so the row is rebuilt once per widening rather than on
+    // every overflowing add. An 8 bit row cannot lose to 16 bits before one entry in 8 overflows.
+    if(bits == 16){
+        if(chooseWidth(length, 0, overflow.size()) > 16) encode(decode());
+        return;
+    }
+    if(overflow.size() * 8 <= (size_t) length) return;
+    size_t over16 = 0;
+    for(const pair<int, int>& stored : overflow){
+        if(stored.second < 0 || stored.second >= 0xFFFF) over16++;
+    }
+    if(chooseWidth(length, overflow.size(), over16) > 8) encode(decode());
+}
+
+void compactCountRow::decode(int * out) const{
+    if(bits == 32){
+        copy(wide.begin(), wide.end(), out);
+        return;
+    }
+    if(bits == 8){
+        const uint8_t * in = narrow8.data();
+        for(int j=0; j<length; j++){
+            out[j] = in[j];
+        }
+    } else {
+        const uint16_t * in = narrow16.data();
+        for(int j=0; j<length; j++){
+            out[j] = in[j];
+        }
+    }
+    for(const pair<int, int>& entry : overflow){
+        out[entry.first] = entry.second;
+    }
+}
+
+vector<int> compactCountRow::decode() const{
+    vector<int> counts(length);
+    decode(counts.data());
+    return counts;
+}
+
+int compactCountRow::nonzeros() const{
+    int result = 0;
+    if(bits == 8){
+        for(uint8_t value : narrow8) result += value != 0;
+    } else if(bits == 16){
+        for(uint16_t value : narrow16) result += value != 0;
+    } else {
+        for(int32_t value : wide) result += value != 0;
+    }
+    // Escaped entries hold large or negative counts, never zero
+    return result;
+}
+
+size_t compactCountRow::bytes() const{
+    return narrow8.size() + 2 * narrow16.size() + 4 * wide.size() + sizeof(pair<int, int>) * overflow.size();
+}
+
+int compactCountRow::width() const{
+    return bits;
+}
+
+static void appendVarint(vector<uint8_t>& out, uint32_t value){
+    while(value >= 0x80){
+        out.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t) value);
+}
+
+static uint32_t readVarint(const uint8_t *& p){
+    uint32_t value = 0;
+    int shift = 0;
+    while(*p & 0x80){
+        value |= (uint32_t) (*p++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= (uint32_t) *p++ << shift;
+    return value;
+}
+
+compactDocument::compactDocument(){
+}
+
+compactDocument::compactDocument(const sparseDocument& document){
+    appendVarint(data, (uint32_t) document.size());
+    int previous = 0;
+    for(const pair<int, int>& word : document){
+        if(word.first < previous || word.second <= 0) throw runtime_error("compactDocument needs sorted words with positive counts");
+        appendVarint(data, (uint32_t) (word.first - previous));
+        appendVarint(data, (uint32_t) word.second);
+        previous = word.first;
+    }
+    data.shrink_to_fit();
+}
+
+void compactDocument::decode(sparseDocument& document) const{
+    document.clear();
+    if(data.empty()) return;
+    const uint8_t * p = data.data();
+    uint32_t numWords = readVarint(p);
+    document.resize(numWords);
+    int index = 0;
+    for(uint32_t w=0; w<numWords; w++){
+        index += (int) readVarint(p);
+        document[w].first = index;
+        document[w].second = (int) readVarint(p);
+    }
+}
+
+size_t compactDocument::bytes() const{
+    return data.capacity();
+}
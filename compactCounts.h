@@ -0,0 +1,76 @@
+#ifndef H__COMPACT_COUNTS
+#define H__COMPACT_COUNTS
+
+#include <vector>
+#include <utility> // pair
+#include <stdint.h>
+#include "tokenizer.h"
+
+using namespace std;
+
+// One row of non-negative counts in 8, 16 or 32 bits per entry, whichever needs the fewest bytes for the
+// measured values. Values that do not fit the chosen width are stored as the largest narrow value and
+// kept in a sorted overflow table, so a few large counts do not widen the whole row.
+class compactCountRow {
+
+    public:
+        compactCountRow();
+
+        compactCountRow(const vector<int>& counts);
+
+        int size() const;
+
+        int at(int j) const;
+
+        // Add delta to entry j, the row is re-encoded when a wider width would take fewer bytes
+        void add(int j, int delta);
+
+        // Widen the whole row into out[0, size()), a plain widening loop the compiler vectorizes
+        void decode(int * out) const;
+
+        vector<int> decode() const;
+
+        // Entries different from zero
+        int nonzeros() const;
+
+        // Bytes held by the row, the overflow table included
+        size_t bytes() const;
+
+        // Bits per entry, 8, 16 or 32
+        int width() const;
+
+    private:
+        int length;
+        int bits;
+        vector<uint8_t> narrow8;
+        vector<uint16_t> narrow16;
+        vector<int32_t> wide;
+
+        // (index, value) of every entry stored as the escape value, sorted by index
+        vector<pair<int, int>> overflow;
+
+        int escape() const;
+
+        void encode(const vector<int>& counts);
+};
+
+// Sparse document as LEB128 varints of the index gap and the count of every word, usually 2 to 3 bytes
+// per word instead of 8. Words must be sorted by index and counts must be positive, as tokenizeText and
+// readSparseCsv produce them.
+class compactDocument {
+
+    public:
+        compactDocument();
+
+        compactDocument(const sparseDocument& document);
+
+        // Decode into document, reusing its storage
+        void decode(sparseDocument& document) const;
+
+        size_t bytes() const;
+
+    private:
+        vector<uint8_t> data;
+};
+
+#endif
@@ -0,0 +1,197 @@
+#include "countShard.h"
+#include "pythonpp.h"
+#include "profiler.h"
+#include <fstream>
+#include <thread>
+#include <stdexcept> // runtime_error
+
+using namespace std;
+
+uint64_t vocabularyFingerprint(const vector<string>& vocab, const vector<string>& labels){
+    // FNV-1a over every line, a newline after each keeps ("ab", "c") apart from ("a", "bc")
+    uint64_t hash = 14695981039346656037ULL;
+    for(const vector<string>* lines : {&vocab, &labels}){
+        for(const string& line : *lines){
+            for(unsigned char c : line){
+                hash = (hash ^ c) * 1099511628211ULL;
+            }
+            hash = (hash ^ '\n') * 1099511628211ULL;
+        }
+        hash = (hash ^ 0xFF) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+template <typename T>
+static void writeRaw(ofstream& out, T value){
+    out.write((const char *) &value, sizeof(T));
+}
+
+template <typename T>
+static T readRaw(ifstream& in){
+    T value;
+    if(!in.read((char *) &value, sizeof(T))) throw runtime_error("Truncated shard file");
+    return value;
+}
+
+static void writeSparseTable(ofstream& out, const vector<vector<int>>& table){
+    for(const vector<int>& row : table){
+        int32_t nonzeros = 0;
+        for(int count : row){
+            nonzeros += count != 0;
+        }
+        writeRaw(out, nonzeros);
+        for(int j=0; j<row.size(); j++){
+            if(row[j] == 0) continue;
+            writeRaw(out, (int32_t) j);
+            writeRaw(out, (int32_t) row[j]);
+        }
+    }
+}
+
+static void readSparseTable(ifstream& in, vector<vector<int>>& table, int numClasses, int numWords){
+    table.assign(numClasses, vector<int>(numWords, 0));
+    for(int i=0; i<numClasses; i++){
+        int32_t nonzeros = readRaw<int32_t>(in);
+        for(int e=0; e<nonzeros; e++){
+            int32_t j = readRaw<int32_t>(in);
+            int32_t count = readRaw<int32_t>(in);
+            if(j < 0 || j >= numWords) throw runtime_error("Word index out of range in shard file");
+            table[i][j] = count;
+        }
+    }
+}
+
+void writeCountShard(const string& file, const countShard& shard){
+    scopedTimer timer("write_count_shard");
+    ofstream out(file, ios::binary);
+    if(!out.is_open()) throw runtime_error("Could not write " + file);
+    out.write("NBS1", 4);
+    writeRaw(out, shard.vocabularyHash);
+    writeRaw(out, (int32_t) shard.numClasses);
+    writeRaw(out, (int32_t) shard.numWords);
+    writeRaw(out, (int32_t) shard.numDocuments);
+    for(int i=0; i<shard.numClasses; i++){
+        writeRaw(out, (int32_t) shard.classRepresentation[i]);
+    }
+    for(int i=0; i<shard.numClasses; i++){
+        writeRaw(out, (int32_t) shard.rawCount[i]);
+    }
+    writeSparseTable(out, shard.wordToClassCount);
+    writeSparseTable(out, shard.wordToClassDocFreq);
+    out.close();
+}
+
+countShard readCountShard(const string& file){
+    scopedTimer timer("read_count_shard");
+    ifstream in(file, ios::binary);
+    if(!in.is_open()) throw runtime_error("Could not open " + file);
+    char magic[4];
+    if(!in.read(magic, 4) || string(magic, 4) != "NBS1") throw runtime_error(file + " is not a count shard");
+    countShard shard;
+    shard.vocabularyHash = readRaw<uint64_t>(in);
+    shard.numClasses = readRaw<int32_t>(in);
+    shard.numWords = readRaw<int32_t>(in);
+    shard.numDocuments = readRaw<int32_t>(in);
+    shard.classRepresentation.resize(shard.numClasses);
+    for(int i=0; i<shard.numClasses; i++){
+        shard.classRepresentation[i] = readRaw<int32_t>(in);
+    }
+    shard.rawCount.resize(shard.numClasses);
+    for(int i=0; i<shard.numClasses; i++){
+        shard.rawCount[i] = readRaw<int32_t>(in);
+    }
+    readSparseTable(in, shard.wordToClassCount, shard.numClasses, shard.numWords);
+    readSparseTable(in, shard.wordToClassDocFreq, shard.numClasses, shard.numWords);
+    return shard;
+}
+
+void mergeCountShard(countShard& shard, const countShard& other){
+    if(shard.vocabularyHash != other.vocabularyHash || shard.numClasses != other.numClasses || shard.numWords != other.numWords){
+        throw runtime_error("Count shards of different vocabularies or labels cannot be merged");
+    }
+    shard.numDocuments += other.numDocuments;
+    for(int i=0; i<shard.numClasses; i++){
+        shard.classRepresentation[i] += other.classRepresentation[i];
+        shard.rawCount[i] += other.rawCount[i];
+        int * counts = shard.wordToClassCount[i].data();
+        int * docFreq = shard.wordToClassDocFreq[i].data();
+        const int * otherCounts = other.wordToClassCount[i].data();
+        const int * otherDocFreq = other.wordToClassDocFreq[i].data();
+        for(int j=0; j<shard.numWords; j++){
+            counts[j] += otherCounts[j];
+            docFreq[j] += otherDocFreq[j];
+        }
+    }
+}
+
+countShard mergeCountShardFiles(const vector<string>& files, int numThreads){
+    scopedTimer timer("merge_count_shards");
+    if(files.empty()) throw runtime_error("No shards to merge");
+    if(numThreads <= 0) numThreads = max(1, (int) thread::hardware_concurrency());
+    numThreads = min(numThreads, (int) files.size());
+
+    // Leaves: every thread reads and folds its own group of files
+    vector<countShard> partial(numThreads);
+    vector<string> errors(numThreads);
+    vector<thread> workers;
+    for(int t=0; t<numThreads; t++){
+        workers.push_back(thread([&, t](){
+            try {
+                size_t first = files.size() * t / numThreads;
+                size_t last = files.size() * (t + 1) / numThreads;
+                partial[t] = readCountShard(files[first]);
+                for(size_t f=first + 1; f<last; f++){
+                    mergeCountShard(partial[t], readCountShard(files[f]));
+                }
+            } catch(const exception& error){
+                errors[t] = error.what();
+            }
+        }));
+    }
+    for(thread& worker : workers){
+        worker.join();
+    }
+    for(const string& error : errors){
+        if(!error.empty()) throw runtime_error(error);
+    }
+
+    // Rounds of pairwise merges until one accumulator is left
+    for(int stride=1; stride<numThreads; stride*=2){
+        workers.clear();
+        for(int t=0; t + stride<numThreads; t+=2*stride){
+            workers.push_back(thread([&, t, stride](){
+                try {
+                    mergeCountShard(partial[t], partial[t + stride]);
+                    partial[t + stride] = countShard();
+                } catch(const exception& error){
+                    errors[t] = error.what();
+                }
+            }));
+        }
+        for(thread& worker : workers){
+            worker.join();
+        }
+        for(const string& error : errors){
+            if(!error.empty()) throw runtime_error(error);
+        }
+    }
+    return move(partial[0]);
+}
+
+void writeModelFiles(const countShard& shard){
+    scopedTimer timer("write_model_files");
+    ofstream file;
+    file.open("rawCount.vec");
+    writeIntVectorToFile(shard.rawCount, file);
+    file.close();
+    file.open("classRepresentation.vec");
+    writeIntVectorToFile(shard.classRepresentation, file);
+    file.close();
+    file.open("wordToClassCount.mtx");
+    writeIntMatrixToFile(shard.wordToClassCount, file);
+    file.close();
+    file.open("wordToClassDocFreq.mtx");
+    writeIntMatrixToFile(shard.wordToClassDocFreq, file);
+    file.close();
+}
@@ -0,0 +1,44 @@
+#ifndef H__COUNT_SHARD
+#define H__COUNT_SHARD
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+// Naive Bayes counts of one partition of the training data. Shards of the same vocabulary and labels add up
+// to the counts of their union, so training can be split over processes and merged afterwards.
+struct countShard {
+    uint64_t vocabularyHash;  // Fingerprint of the vocabulary and label files the counts refer to
+    int numClasses;
+    int numWords;
+    int numDocuments;
+    vector<vector<int>> wordToClassCount;
+    vector<vector<int>> wordToClassDocFreq;
+    vector<int> rawCount;
+    vector<int> classRepresentation;
+};
+
+// Fingerprint of a vocabulary and its labels, shards only merge when their fingerprints match
+uint64_t vocabularyFingerprint(const vector<string>& vocab, const vector<string>& labels);
+
+// Binary shard file: "NBS1", the fingerprint, the sizes and document count, classRepresentation, rawCount,
+// then both count tables class by class as a nonzero count followed by (word, count) pairs. Integers are
+// int32 in host byte order apart from the 64 bit fingerprint.
+void writeCountShard(const string& file, const countShard& shard);
+
+countShard readCountShard(const string& file);
+
+// Add the counts of other to shard, throws if they do not describe the same vocabulary and labels
+void mergeCountShard(countShard& shard, const countShard& other);
+
+// Read and merge shard files with numThreads threads: every thread folds a contiguous group of files into
+// its own accumulator, then the accumulators are merged pairwise in rounds. numThreads <= 0 uses every hardware thread.
+countShard mergeCountShardFiles(const vector<string>& files, int numThreads);
+
+// Write the files NaiveBayes and the Bernoulli model load: wordToClassCount.mtx, wordToClassDocFreq.mtx,
+// rawCount.vec and classRepresentation.vec in the current directory
+void writeModelFiles(const countShard& shard);
+
+#endif
@@ -0,0 +1,292 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <queue>
+#include <utility> // pair
+#include <stdexcept> // runtime_error
+#include <sstream> // stringstream
+#include <time.h>
+#include <chrono>
+#include <stdlib.h>
+#include <unordered_map>
+#include "pythonpp.h"
+
+
+using namespace std;
+
+// Maps the string values of every column to dense integer codes so that trees can be
+// evaluated on an int matrix instead of string dataframes
+class categoricalEncoder {
+
+    public:
+        // Sorted unique values of every column, the position of a value is its code
+        vector<vector<string>> values;
+
+        // Value to code lookup for every column
+        vector<unordered_map<string, int>> codes;
+
+        categoricalEncoder() {}
+
+        categoricalEncoder(const vector<vector<string>>& data) {
+            for (int j = 0; j < data.at(0).size(); j++) {
+                values.push_back(getUniqueAttributes(data, j));
+                codes.push_back(make_dict(values.at(j)));
+            }
+        }
+
+        int numColumns() {
+            return (int) values.size();
+        }
+
+        // Code of a value in a column, -1 if the value was never seen during training
+        int encode(int column, const string& value) {
+            unordered_map<string, int>::iterator it = codes.at(column).find(value);
+            if (it == codes.at(column).end()) return -1;
+            return it->second;
+        }
+
+        // Encode a dataframe into a row major int matrix with numColumns() codes per row
+        vector<int> encode(const vector<vector<string>>& data) {
+            vector<int> result(data.size() * values.size(), -1);
+            for (int i = 0; i < data.size(); i++) {
+                for (int j = 0; j < data.at(i).size() && j < values.size(); j++) {
+                    result[i * values.size() + j] = encode(j, data.at(i).at(j));
+                }
+            }
+            return result;
+        }
+};
+
+// Compact node of a flattened tree. Nodes are stored breadth first in a single array and the
+// children of an internal node are contiguous, so the child taken by a row whose attribute has
+// value code c is simply nodes[firstChild + c]. No pointers are chased during inference.
+struct flatNode {
+    int feature;    // Attribute column tested at this node, -1 for leaves
+    int firstChild; // Offset of the first child in the node array
+    int label;      // Majority class code. Used for leaves and for values unseen at this node
+};
+
+class decisionTree {
+
+    public:
+        // Breadth first node array, the root is nodes[0]
+        vector<flatNode> nodes;
+
+        // Depth of the deepest leaf
+        int depth;
+
+        decisionTree() {
+            depth = 0;
+        }
+
+        // Grow a tree level by level directly into the flat array. The target must be the last column.
+        decisionTree(const vector<vector<string>>& data, categoricalEncoder& encoder, const string& criterion, double confidence, int maxDepth) {
+            int target = (int) data.at(0).size() - 1;
+            depth = 0;
+
+            queue<pair<int, vector<vector<string>>>> pending; // node index, rows reaching that node
+            queue<int> pendingDepth;
+            nodes.push_back(flatNode{-1, 0, majorityClass(data, encoder, target)});
+            pending.push(make_pair(0, data));
+            pendingDepth.push(0);
+
+            while (!pending.empty()) {
+                int node = pending.front().first;
+                vector<vector<string>> nodeData = move(pending.front().second);
+                int nodeDepth = pendingDepth.front();
+                pending.pop();
+                pendingDepth.pop();
+                depth = max(depth, nodeDepth);
+
+                if (nodeDepth >= maxDepth || getUniqueAttributes(nodeData, target).size() < 2) {
+                    continue;
+                }
+                int attribute = getMaxGainIndex(nodeData, criterion, target);
+                if (getGain(nodeData, criterion, attribute, target) <= 0) {
+                    continue;
+                }
+                // Pre-pruning: only split when the attribute is significant
+                int numValues = (int) encoder.values.at(attribute).size();
+                int numClasses = (int) encoder.values.at(target).size();
+                vector<int> table(numValues * numClasses, 0);
+                for (int i = 0; i < nodeData.size(); i++) {
+                    table[encoder.encode(attribute, nodeData.at(i).at(attribute)) * numClasses + encoder.encode(target, nodeData.at(i).at(target))] += 1;
+                }
+                if (!chiSquaredTest(table, numValues, numClasses, confidence)) {
+                    continue;
+                }
+
+                int firstChild = (int) nodes.size();
+                nodes.at(node).feature = attribute;
+                nodes.at(node).firstChild = firstChild;
+
+                // Every value of the attribute gets a slot, values absent here fall back to this node's label
+                vector<vector<vector<string>>> children(numValues);
+                for (int i = 0; i < nodeData.size(); i++) {
+                    children.at(encoder.encode(attribute, nodeData.at(i).at(attribute))).push_back(nodeData.at(i));
+                }
+                for (int c = 0; c < numValues; c++) {
+                    int label = children.at(c).empty() ? nodes.at(node).label : majorityClass(children.at(c), encoder, target);
+                    nodes.push_back(flatNode{-1, 0, label});
+                }
+                for (int c = 0; c < numValues; c++) {
+                    if (!children.at(c).empty()) {
+                        pending.push(make_pair(firstChild + c, move(children.at(c))));
+                        pendingDepth.push(nodeDepth + 1);
+                    }
+                }
+            }
+        }
+
+        // Walk a block of rows through the tree together. X is row major with stride codes per row.
+        // Returns the class code reached by every row.
+        vector<int> predictBatch(const vector<int>& X, int numRows, int stride) {
+            vector<int> result(numRows);
+            const int blockSize = 64;
+            int current[blockSize];
+            bool stopped[blockSize];
+            const flatNode * base = nodes.data();
+
+            for (int start = 0; start < numRows; start += blockSize) {
+                int count = min(blockSize, numRows - start);
+                for (int r = 0; r < count; r++) {
+                    current[r] = 0;
+                    stopped[r] = false;
+                }
+
+                // Advance every row in the block one level per pass until all of them rest on a leaf
+                bool active = true;
+                while (active) {
+                    active = false;
+                    for (int r = 0; r < count; r++) {
+                        const flatNode& n = base[current[r]];
+                        if (stopped[r] || n.feature < 0) continue;
+                        int code = X[(size_t) (start + r) * stride + n.feature];
+                        if (code < 0) {
+                            // Unseen value, stop here and use the node's majority class
+                            stopped[r] = true;
+                            continue;
+                        }
+                        current[r] = n.firstChild + code;
+                        active = true;
+                    }
+                }
+                for (int r = 0; r < count; r++) {
+                    result[start + r] = base[current[r]].label;
+                }
+            }
+            return result;
+        }
+
+    private:
+        int majorityClass(const vector<vector<string>>& data, categoricalEncoder& encoder, int target) {
+            vector<pair<string, int>> instances = getValueInstances(data, target);
+            int maxIndex = 0;
+            for (int i = 1; i < instances.size(); i++) {
+                if (instances.at(i).second > instances.at(maxIndex).second) maxIndex = i;
+            }
+            return encoder.encode(target, instances.at(maxIndex).first);
+        }
+};
+
+class randomForest {
+
+    public:
+        vector<decisionTree> trees;
+
+        // Shared value codes of the training data
+        categoricalEncoder encoder;
+
+        // Number of classes in the target column
+        int numClasses;
+
+        // Train numTrees trees on bootstrap samples of data. The target must be the last column.
+        randomForest(const vector<vector<string>>& data, const string& criterion, double confidence, int maxDepth, int numTrees) {
+            encoder = categoricalEncoder(data);
+            numClasses = (int) encoder.values.back().size();
+
+            // Every split the trees can test has at most this many degrees of freedom
+            int maxValues = 0;
+            for (int j = 0; j < (int) encoder.values.size() - 1; j++) {
+                maxValues = max(maxValues, (int) encoder.values.at(j).size());
+            }
+            precomputeChiSquaredCritical((numClasses - 1) * (maxValues - 1), confidence);
+
+            for (int t = 0; t < numTrees; t++) {
+                // A single tree sees the whole dataset, a forest bootstrap samples
+                vector<vector<string>> sample;
+                if (numTrees > 1) {
+                    mt19937 rng(t);
+                    uniform_int_distribution<int> pick(0, (int) data.size() - 1);
+                    for (int i = 0; i < data.size(); i++) {
+                        sample.push_back(data.at(pick(rng)));
+                    }
+                }
+                trees.push_back(decisionTree(numTrees == 1 ? data : sample, encoder, criterion, confidence, maxDepth));
+            }
+        }
+
+        // Majority vote of all trees for every row of a dataframe. Returns class codes.
+        vector<int> predictBatch(const vector<vector<string>>& data) {
+            int numRows = (int) data.size();
+            int stride = encoder.numColumns();
+            vector<int> X = encoder.encode(data);
+            vector<int> votes((size_t) numRows * numClasses, 0);
+
+            for (int t = 0; t < trees.size(); t++) {
+                vector<int> predictions = trees.at(t).predictBatch(X, numRows, stride);
+                for (int i = 0; i < numRows; i++) {
+                    votes[(size_t) i * numClasses + predictions[i]] += 1;
+                }
+            }
+
+            vector<int> result(numRows);
+            for (int i = 0; i < numRows; i++) {
+                int * row = &votes[(size_t) i * numClasses];
+                result[i] = (int) (max_element(row, row + numClasses) - row);
+            }
+            return result;
+        }
+
+        string className(int code) {
+            return encoder.values.back().at(code);
+        }
+};
+
+int runDT(int argc, char** argv) {
+    if(argc < 8){
+        cerr << "Usage: " << argv[0] << " dt <train.csv> <test.csv> <criterion> <confidence> <maxDepth> <numTrees>" << endl;
+        return 0;
+    }
+    // Both files are expected to have headers and the target as the last column
+    vector<vector<string>> train = seperateHeader(read_csv(argv[2])).second;
+    vector<vector<string>> test = seperateHeader(read_csv(argv[3])).second;
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    randomForest forest(train, argv[4], stod(argv[5]), stoi(argv[6]), stoi(argv[7]));
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    begin = chrono::steady_clock::now();
+    vector<int> predictions = forest.predictBatch(test);
+    end = chrono::steady_clock::now();
+    std::cout << "Time to predict = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    double correct = 0.0;
+    double total = 0.0;
+    for (int i = 0; i < test.size(); i++) {
+        if (forest.className(predictions.at(i)).compare(test.at(i).back()) == 0) {
+            correct = correct + 1.0;
+        }
+        total = total + 1.0;
+    }
+
+    ofstream record;
+    record.open("last_run_info.txt");
+    record << "Total: " << total << endl << "Correct: " << correct << endl << "Accuracy: " << (correct/total) * 100 << "%" << endl;
+    record.close();
+    return 0;
+}
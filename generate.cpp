@@ -0,0 +1,132 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <stdexcept> // runtime_error
+#include <sys/stat.h>
+#include "synthetic.h"
+
+using namespace std;
+
+// Documents generated by one worker task. Every block has its own seed, so the output does not depend on the thread count.
+const int blockDocuments = 1024;
+
+// Format the documents of one block in every requested format
+static void generateBlock(const syntheticCorpus& corpus, int block, int numDocuments, int firstId, bool labelled,
+                          bool writeCsv, bool writeSparse, string& csv, string& sparse){
+    seed_seq seeds = {corpus.config.seed, (unsigned) block, (unsigned) labelled};
+    mt19937 rng(seeds);
+    csv.clear();
+    sparse.clear();
+    int begin = block * blockDocuments;
+    int end = min(numDocuments, begin + blockDocuments);
+    for(int i=begin; i<end; i++){
+        int _class = corpus.drawClass(rng);
+        vector<pair<int, int>> document = corpus.document(_class, rng);
+        if(writeCsv) appendCsvRow(csv, firstId + i, document, corpus.config.vocabularySize, labelled ? _class : 0);
+        if(writeSparse) appendBinaryDocument(sparse, firstId + i, labelled ? _class : 0, document);
+    }
+}
+
+// Generate numDocuments documents with numThreads workers and stream them to disk in order. Workers fill the
+// next round of blocks while the previous round is written out.
+static void generateCorpus(const syntheticCorpus& corpus, int numDocuments, int firstId, bool labelled,
+                           const string& csvFile, const string& sparseFile, int numThreads){
+    ofstream csv;
+    ofstream sparse;
+    if(!csvFile.empty()) csv.open(csvFile, ios::binary);
+    if(!sparseFile.empty()){
+        sparse.open(sparseFile, ios::binary);
+        string header;
+        appendBinaryHeader(header, numDocuments, corpus.config.vocabularySize, labelled ? corpus.config.numClasses : 0);
+        sparse.write(header.data(), header.size());
+    }
+
+    int numBlocks = (numDocuments + blockDocuments - 1) / blockDocuments;
+    vector<string> csvBlocks[2] = {vector<string>(numThreads), vector<string>(numThreads)};
+    vector<string> sparseBlocks[2] = {vector<string>(numThreads), vector<string>(numThreads)};
+    int numRounds = (numBlocks + numThreads - 1) / numThreads;
+    for(int round=0; round<=numRounds; round++){
+        int current = round % 2;
+        int previous = 1 - current;
+        vector<thread> workers;
+        if(round < numRounds){
+            for(int t=0; t<numThreads; t++){
+                int block = round * numThreads + t;
+                if(block >= numBlocks) break;
+                workers.push_back(thread([&, block, t, current](){
+                    generateBlock(corpus, block, numDocuments, firstId, labelled, csv.is_open(), sparse.is_open(),
+                                  csvBlocks[current][t], sparseBlocks[current][t]);
+                }));
+            }
+        }
+        if(round > 0){
+            for(int t=0; t<numThreads; t++){
+                if(csv.is_open()) csv.write(csvBlocks[previous][t].data(), csvBlocks[previous][t].size());
+                if(sparse.is_open()) sparse.write(sparseBlocks[previous][t].data(), sparseBlocks[previous][t].size());
+                csvBlocks[previous][t].clear();
+                sparseBlocks[previous][t].clear();
+            }
+        }
+        for(thread& worker : workers){
+            worker.join();
+        }
+    }
+    if(csv.is_open()) csv.close();
+    if(sparse.is_open()) sparse.close();
+}
+
+int main(int argc, char** argv){
+    if(argc < 6){
+        cerr << "Usage: " << argv[0] << " <outputDir> <numDocuments> <vocabularySize> <numClasses> <density> [classSkew] [csv|sparse|both] [numTestDocuments] [numThreads] [seed]" << endl;
+        return 0;
+    }
+    string outputDir = argv[1];
+    syntheticCorpusConfig config;
+    config.numDocuments = atoi(argv[2]);
+    config.vocabularySize = atoi(argv[3]);
+    config.numClasses = atoi(argv[4]);
+    config.density = atof(argv[5]);
+    config.zipfExponent = 1.0;
+    config.classSkew = argc > 6 ? atof(argv[6]) : 0.0;
+    string format = argc > 7 ? argv[7] : "csv";
+    int numTest = argc > 8 ? atoi(argv[8]) : 0;
+    int numThreads = argc > 9 ? atoi(argv[9]) : 0;
+    config.seed = argc > 10 ? (unsigned) atoi(argv[10]) : 7;
+    if(numThreads <= 0) numThreads = max(1, (int) thread::hardware_concurrency());
+    bool writeCsv = format.compare("sparse") != 0;
+    bool writeSparse = format.compare("csv") != 0;
+
+    mkdir(outputDir.c_str(), 0755);
+    string prefix = outputDir + "/";
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    syntheticCorpus corpus(config);
+
+    ofstream lines;
+    lines.open(prefix + "vocabulary.txt");
+    if(!lines.is_open()) throw runtime_error("Could not write to " + outputDir);
+    for(const string& word : syntheticVocabulary(config.vocabularySize)) lines << word << "\n";
+    lines.close();
+    lines.open(prefix + "newsgrouplabels.txt");
+    for(const string& label : syntheticLabels(config.numClasses)) lines << label << "\n";
+    lines.close();
+
+    // Training rows are labelled and numbered from 1, test rows carry no label and continue the ids
+    generateCorpus(corpus, config.numDocuments, 1, true, writeCsv ? prefix + "training.csv" : "",
+                   writeSparse ? prefix + "training.spc" : "", numThreads);
+    if(numTest > 0){
+        generateCorpus(corpus, numTest, config.numDocuments + 1, false, writeCsv ? prefix + "testing.csv" : "",
+                       writeSparse ? prefix + "testing.spc" : "", numThreads);
+    }
+
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Generated " << config.numDocuments << " training and " << numTest << " test documents over " << config.vocabularySize
+              << " words with " << numThreads << " threads" << std::endl;
+    std::cout << "Time to generate = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+    return 0;
+}
@@ -12,7 +12,13 @@
 #include <stdlib.h>
 #include <math.h>  
 #include <unordered_map>
+#include <thread>
 #include "pythonpp.h"
+#include "tokenizer.h"
+#include "scoringPipeline.h"
+#include "scoringServer.h"
+#include "profiler.h"
+#include "prunedScoring.h"
 #include <Eigen/Dense>
 #include <Eigen/Core>
 #include <unsupported/Eigen/MatrixFunctions>
@@ -20,6 +26,14 @@
 using namespace Eigen;
 using namespace std;
 
+// One configuration of a grid search and its validation accuracy after the given number of iterations
+struct gridResult {
+    double learningRate;
+    double penaltyTerm;
+    int iterations;
+    double accuracy;
+};
+
 class logisticRegression{
     private:
         int m; //Number of examples
@@ -33,7 +47,10 @@ class logisticRegression{
         MatrixXd XT; //Transpose 
         MatrixXd Y; //True Classification matrix
         MatrixXd W; //Weight matrix
+        VectorXd columnSums; //Sums every column of X was divided by
         MatrixXd probMatrix; //Probability Matrix
+        VectorXd pruningUpper; //Largest weight of every column of W, empty unless pruning is enabled
+        VectorXd pruningLower; //Smallest weight of every column of W
 
         // // Matrix of word counts in a class
         vector<vector<int>> countMatrix;
@@ -41,7 +58,133 @@ class logisticRegression{
         // Vector containing total representation for each class
         vector<int> classRepresentation;
 
-        void createXY(vector<vector<int>> data){
+        // Vocabulary indices used as features, column j + 1 of X is word featureMask[j]
+        vector<int> featureMask;
+
+        // Position of every vocabulary word in featureMask, -1 for words outside the mask
+        vector<int> featureColumn;
+
+        // List of words, empty for hashed models
+        vector<string> vocab;
+
+        // Number of hashed feature bits when trained with the hashing trick, 0 when using the vocabulary
+        int hashBits;
+
+        // Whether hashed tokens carry a sign
+        bool signedHashing;
+
+        // Nonzero (column, value) entries of every row of X, built on the first sparse training run
+        vector<vector<pair<int, double>>> sparseRows;
+
+        // Number of steps whose L2 decay has been applied to every column of W, the rest is owed
+        vector<long long> decayedSteps;
+
+        void buildSparseRows(){
+            if (!sparseRows.empty()) return;
+            sparseRows.resize(m);
+            for (int i = 0; i < m; i++) {
+                for (int j = 0; j < n + 1; j++) {
+                    if (X(i, j) != 0) sparseRows[i].push_back(make_pair(j, X(i, j)));
+                }
+            }
+        }
+
+        // Apply the decay column j still owes for the steps before step, (1 - lr * pt)^missed in one multiplication
+        void catchUpDecay(int j, long long step, double decay){
+            if (decayedSteps[j] < step) {
+                W.col(j) *= pow(decay, (double) (step - decayedSteps[j]));
+                decayedSteps[j] = step;
+            }
+        }
+
+        static double relaxedLoad(const double * p){
+            double value;
+            __atomic_load(p, &value, __ATOMIC_RELAXED);
+            return value;
+        }
+
+        static void relaxedStore(double * p, double value){
+            __atomic_store(p, &value, __ATOMIC_RELAXED);
+        }
+
+        // Advance the decay of column j to step and return the factor the calling thread must apply to it,
+        // 1 when another thread already advanced it that far
+        double claimDecay(int j, long long step, double decay){
+            long long done = __atomic_load_n(&decayedSteps[j], __ATOMIC_RELAXED);
+            while (done < step) {
+                if (__atomic_compare_exchange_n(&decayedSteps[j], &done, step, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                    return pow(decay, (double) (step - done));
+                }
+            }
+            return 1.0;
+        }
+
+        void reportEpoch(int epoch, long long ms, bool reportLoss){
+            cout << "Epoch " << epoch << ": " << ms << "[ms]";
+            if (reportLoss) {
+                double accuracy;
+                double loss = trainingLoss(accuracy);
+                cout << ", training loss " << loss << ", training accuracy " << accuracy * 100 << "%";
+            }
+            cout << endl;
+        }
+
+        void catchUpAllDecay(long long step, double decay){
+            for (int j = 0; j < n + 1; j++) {
+                catchUpDecay(j, step, decay);
+            }
+        }
+
+        // numItr full batch updates of train() for every configuration stacked in weights, block g of k rows
+        // with rates[g] and penalties[g]. X is only read, one product with XT and one with X per iteration.
+        void trainStacked(MatrixXd& weights, const vector<double>& rates, const vector<double>& penalties, int numItr){
+            int groupSize = (int) rates.size();
+            for (int itr = 0; itr < numItr; itr++) {
+                scopedTimer timer("lr_grid_iteration");
+                profileCount("lr_flops", 4LL * groupSize * k * (n + 1) * m);
+                MatrixXd probabilities = weights * XT;
+                for (int g = 0; g < groupSize; g++) {
+                    Block<MatrixXd> block = probabilities.middleRows(g * k, k);
+                    for (int i = 0; i < m; i++) {
+                        double sum = block.col(i).sum();
+                        if (sum != 0) block.col(i) /= sum;
+                    }
+                    block = delta - block.array().exp().matrix();
+                }
+                MatrixXd update = probabilities * X;
+                for (int g = 0; g < groupSize; g++) {
+                    weights.middleRows(g * k, k) += rates[g] * (update.middleRows(g * k, k) - penalties[g] * weights.middleRows(g * k, k));
+                }
+            }
+        }
+
+        // Fraction of the documents every configuration stacked in weights gets right, scored like predict
+        vector<double> stackedAccuracy(const MatrixXd& weights, const vector<sparseDocument>& documents, const vector<int>& labels){
+            int groupSize = (int) weights.rows() / k;
+            vector<int> correct(groupSize, 0);
+            VectorXd results(weights.rows());
+            for (int d = 0; d < documents.size(); d++) {
+                results = weights.col(0);
+                for (const pair<int, int>& word : documents[d]) {
+                    int column = featureColumn[word.first];
+                    if (column >= 0) {
+                        results += word.second * weights.col(column + 1);
+                    }
+                }
+                for (int g = 0; g < groupSize; g++) {
+                    int maxIndex;
+                    results.segment(g * k, k).maxCoeff(&maxIndex);
+                    if (maxIndex + 1 == labels[d]) correct[g]++;
+                }
+            }
+            vector<double> accuracy(groupSize);
+            for (int g = 0; g < groupSize; g++) {
+                accuracy[g] = documents.empty() ? 0.0 : (double) correct[g] / documents.size();
+            }
+            return accuracy;
+        }
+
+        void createXY(const vector<vector<int>>& data){
             cout << "start createXY" << endl;
             X.resize(m, n + 1);
             Y.resize(m, 1);
@@ -49,27 +192,32 @@ class logisticRegression{
             for(int i=0; i< data.size(); i++){
                 X(i, 0) = 1;
                 Y(i, 0) = data.at(i).at(data.at(i).size() - 1);
-                for(int j=1; j<data.at(i).size() - 1; j++){
-                    X(i, j) = data.at(i).at(j);
+                for(int j=0; j<n; j++){
+                    X(i, j + 1) = data.at(i).at(featureMask[j]);
                 }
             }
             cout << "Done" << endl;
             return;
         }
 
-        MatrixXd createTestX(vector<vector<int>> data){
-            MatrixXd result((int) data.size(), (int) data.at(0).size() + 1);
+        MatrixXd createTestX(const vector<vector<int>>& data){
+            MatrixXd result((int) data.size(), n + 1);
 
             for(int i=0; i< data.size(); i++){
                 result(i, 0) = 1;
-                for(int j=1; j<data.at(i).size(); j++){
-                    result(i, j) = data.at(i).at(j);
+                for(int j=0; j<n; j++){
+                    result(i, j + 1) = data.at(i).at(featureMask[j]);
                 }
             }
 
             return result;
         }
 
+        sparseDocument readDocument(const string& path, const perfectHashVocabulary& lookup){
+            if (hashBits > 0) return hashFile(path, hashBits, signedHashing);
+            return tokenizeFile(path, lookup);
+        }
+
         void Exp(MatrixXd& matrix){
             for(int i=0; i<k; i++){
                 for(int j=0; j<m; j++){
@@ -93,7 +241,7 @@ class logisticRegression{
 
     public:
         // Hyperparams still missing
-        logisticRegression(string trainFile, string vocab_file, string labels_file, double lr, double pt, int ni){
+        logisticRegression(string trainFile, string vocab_file, string labels_file, double lr, double pt, int ni, const vector<int>& mask = vector<int>()){
             // Hyperparams
             learningRate = lr; //Learning rate
             penaltyTerm = pt; //Penalty term
@@ -104,8 +252,24 @@ class logisticRegression{
             cout << "num Itr: " << numItr << endl;
 
             // Load labels and vocab from files
-            n = (int) (read_lines(vocab_file)).size();
+            vocab = read_lines(vocab_file);
+            n = (int) vocab.size();
             k = (int) (read_lines(labels_file)).size();
+            hashBits = 0;
+            signedHashing = false;
+
+            // Restrict the features to the selected words, or keep the whole vocabulary
+            featureMask = mask;
+            if (featureMask.empty()) {
+                for (int j = 0; j < n; j++) {
+                    featureMask.push_back(j);
+                }
+            }
+            featureColumn.assign(n, -1);
+            for (int j = 0; j < featureMask.size(); j++) {
+                featureColumn.at(featureMask[j]) = j;
+            }
+            n = (int) featureMask.size();
 
             classRepresentation = read_vec_int("classRepresentation.vec");
 
@@ -137,15 +301,68 @@ class logisticRegression{
             }
 
             //Normalize X
+            columnSums = X.colwise().sum();
             normalizeMatrix(X);
 
             //Transpose X and multiply with W
             XT = X.transpose();
         }
 
+        // Train on raw text documents with the hashing trick instead of a vocabulary. Every line of the
+        // list file is "<path>,<class>" and each document becomes one row over 2^bits hashed slots.
+        // X stays dense, so keep bits moderate.
+        logisticRegression(string documentList, string labels_file, int bits, bool useSignedHashing, double lr, double pt, int ni){
+            learningRate = lr; //Learning rate
+            penaltyTerm = pt; //Penalty term
+            numItr = ni;
+
+            cout << "Learning Rate: " << learningRate << endl;
+            cout << "Penalty Term: " << penaltyTerm << endl;
+            cout << "num Itr: " << numItr << endl;
+
+            hashBits = bits;
+            signedHashing = useSignedHashing;
+            n = 1 << bits;
+            k = (int) (read_lines(labels_file)).size();
+            for (int j = 0; j < n; j++) {
+                featureMask.push_back(j);
+            }
+            featureColumn = featureMask;
+
+            vector<vector<string>> documents = read_csv(documentList);
+            m = (int) documents.size();
+            X = MatrixXd::Zero(m, n + 1);
+            Y.resize(m, 1);
+            delta = MatrixXd::Zero(k, m);
+            classRepresentation.assign(k, 0);
+            for (int i = 0; i < m; i++) {
+                int _class = stoi(documents.at(i).at(1));
+                X(i, 0) = 1;
+                Y(i, 0) = _class;
+                delta(_class - 1, i) = 1;
+                classRepresentation.at(_class - 1) += 1;
+                for (const pair<int, int>& word : hashFile(documents.at(i).at(0), bits, signedHashing)) {
+                    X(i, word.first + 1) = word.second;
+                }
+            }
+
+            W = MatrixXd::Zero(k, n + 1);
+
+            //Normalize X by absolute column sums, signed slots can sum to zero
+            columnSums = X.cwiseAbs().colwise().sum();
+            for (int j = 0; j < n + 1; j++) {
+                if (columnSums(j) > 0) X.col(j) /= columnSums(j);
+            }
+
+            XT = X.transpose();
+        }
+
         void train() {
             int currItr = 0;
             while (currItr < numItr) {
+                scopedTimer timer("lr_iteration");
+                // Two k x (n + 1) x m products per step
+                profileCount("lr_flops", 4LL * k * (n + 1) * m);
                 cout << "Current iteration: " << currItr << endl;
                 probMatrix = W*XT;
                 normalizeMatrix(probMatrix);
@@ -159,7 +376,307 @@ class logisticRegression{
             }
         }
 
-        int predict(MatrixXd features) {
+        // Start from the Naive Bayes model of the same preprocessing run instead of zero weights. The NB score
+        // of a document is log prior + sum of count * log P(word | class) with beta smoothing, and X holds
+        // counts divided by their column sums, so word column j gets columnSums(j) * log P(word | class) and
+        // the bias column, 1 / m in every row, gets m * log prior. Every column is centered over the classes,
+        // which leaves the softmax unchanged and keeps the L2 penalty from pulling on the shared part.
+        // Meant for trainSparse and trainHogwild: train divides the scores by their sum over the classes,
+        // which is close to zero for centered weights. As in Naive Bayes, beta <= 0 means 1 / |V|. Naive Bayes
+        // never predicts a class without training documents, log prior -inf; such a class starts at the smallest
+        // weight of every column instead, which X >= 0 keeps from ever scoring above the other classes.
+        void warmStartFromNaiveBayes(double beta, string countFile = "wordToClassCount.mtx") {
+            if (hashBits > 0) throw runtime_error("Warm start needs a vocabulary model");
+            if (beta <= 0) beta = 1.0 / (double) featureColumn.size();
+            vector<vector<int>> counts = read_csv_int(countFile);
+            vector<int> rawCount = read_vec_int("rawCount.vec");
+            vector<int> emptyClasses;
+            vector<int> trainedClasses;
+            for (int i = 0; i < k; i++) {
+                if (classRepresentation.at(i) == 0) {
+                    emptyClasses.push_back(i);
+                    continue;
+                }
+                trainedClasses.push_back(i);
+                W(i, 0) = columnSums(0) * log((double) classRepresentation.at(i) / m);
+                double logDenominator = log(rawCount.at(i) + beta * n);
+                for (int j = 0; j < n; j++) {
+                    W(i, j + 1) = columnSums(j + 1) * (log(counts.at(i).at(featureMask[j]) + beta) - logDenominator);
+                }
+            }
+            if (trainedClasses.empty()) throw runtime_error("Warm start needs a class with training documents");
+            if (!emptyClasses.empty()) {
+                RowVectorXd lowest = W.row(trainedClasses[0]);
+                for (int i : trainedClasses) {
+                    lowest = lowest.cwiseMin(W.row(i));
+                }
+                for (int i : emptyClasses) {
+                    W.row(i) = lowest;
+                }
+            }
+            W.rowwise() -= W.colwise().mean();
+        }
+
+        // Mini-batch SGD over the nonzeros of X with the softmax gradient, numItr epochs of batchSize rows.
+        // Every step decays all of W by (1 - learningRate * penaltyTerm), but only the columns a batch touches
+        // are decayed then: each column remembers how many steps it has been decayed for and catches up in
+        // one multiplication when it is next touched, and all columns catch up at the end of each epoch.
+        // A step costs O(k * nonzeros of the batch) instead of O(k * (n + 1)).
+        void trainSparse(int batchSize, bool reportLoss = false) {
+            buildSparseRows();
+            double decay = 1.0 - learningRate * penaltyTerm;
+            decayedSteps.assign(n + 1, 0);
+            long long step = 0;
+            MatrixXd gradient = MatrixXd::Zero(k, n + 1);
+            vector<bool> touched(n + 1, false);
+            vector<int> touchedColumns;
+            vector<int> order(m);
+            for (int i = 0; i < m; i++) {
+                order[i] = i;
+            }
+            mt19937 rng(7);
+            VectorXd scores(k);
+
+            for (int epoch = 0; epoch < numItr; epoch++) {
+                scopedTimer timer("lr_sparse_epoch");
+                chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+                shuffle(order.begin(), order.end(), rng);
+                long long nonzeros = 0;
+                for (int first = 0; first < m; first += batchSize) {
+                    int last = min(m, first + batchSize);
+                    // Columns of the batch are brought up to date before they are read
+                    for (int b = first; b < last; b++) {
+                        for (const pair<int, double>& entry : sparseRows[order[b]]) {
+                            if (!touched[entry.first]) {
+                                touched[entry.first] = true;
+                                touchedColumns.push_back(entry.first);
+                                catchUpDecay(entry.first, step, decay);
+                            }
+                        }
+                    }
+                    for (int b = first; b < last; b++) {
+                        int i = order[b];
+                        scores.setZero();
+                        for (const pair<int, double>& entry : sparseRows[i]) {
+                            scores += entry.second * W.col(entry.first);
+                        }
+                        scores = (scores.array() - scores.maxCoeff()).exp();
+                        scores /= scores.sum();
+                        scores = -scores;
+                        scores((int) Y(i, 0) - 1) += 1.0;
+                        for (const pair<int, double>& entry : sparseRows[i]) {
+                            gradient.col(entry.first) += entry.second * scores;
+                        }
+                        nonzeros += sparseRows[i].size();
+                    }
+                    // This step's decay and gradient for the touched columns, the others owe the decay
+                    for (int j : touchedColumns) {
+                        W.col(j) = decay * W.col(j) + learningRate * gradient.col(j);
+                        gradient.col(j).setZero();
+                        decayedSteps[j] = step + 1;
+                        touched[j] = false;
+                    }
+                    touchedColumns.clear();
+                    step++;
+                }
+                // Checkpoint: W is exact again
+                catchUpAllDecay(step, decay);
+                profileCount("lr_sparse_nonzeros", nonzeros);
+                chrono::steady_clock::time_point end = chrono::steady_clock::now();
+                reportEpoch(epoch, std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count(), reportLoss);
+            }
+        }
+
+        // Hogwild: numThreads workers take interleaved rows of each epoch and update the shared W one row at a
+        // time without locks. W is read and written with relaxed atomic loads and stores, so concurrent updates
+        // of the same weight may overwrite each other, which sparse rows make rare. Row b of an epoch is step
+        // epoch * m + b as in trainSparse with a batch of one, and a column claims its owed decay with a compare
+        // and swap so that it is applied once. numThreads <= 0 uses every hardware thread.
+        void trainHogwild(int numThreads, bool reportLoss = false) {
+            buildSparseRows();
+            if (numThreads <= 0) numThreads = max(1, (int) thread::hardware_concurrency());
+            double decay = 1.0 - learningRate * penaltyTerm;
+            decayedSteps.assign(n + 1, 0);
+            vector<int> order(m);
+            for (int i = 0; i < m; i++) {
+                order[i] = i;
+            }
+            mt19937 rng(7);
+            double * weights = W.data();
+
+            for (int epoch = 0; epoch < numItr; epoch++) {
+                scopedTimer timer("lr_hogwild_epoch");
+                chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+                shuffle(order.begin(), order.end(), rng);
+                long long epochStart = (long long) epoch * m;
+                vector<thread> workers;
+                for (int t = 0; t < numThreads; t++) {
+                    workers.push_back(thread([&, t]() {
+                        vector<double> scores(k);
+                        for (int b = t; b < m; b += numThreads) {
+                            int i = order[b];
+                            long long step = epochStart + b;
+                            // Columns are brought up to date before they are read
+                            for (const pair<int, double>& entry : sparseRows[i]) {
+                                double factor = claimDecay(entry.first, step, decay);
+                                if (factor != 1.0) {
+                                    double * column = weights + (size_t) entry.first * k;
+                                    for (int c = 0; c < k; c++) {
+                                        relaxedStore(column + c, factor * relaxedLoad(column + c));
+                                    }
+                                }
+                            }
+                            fill(scores.begin(), scores.end(), 0.0);
+                            for (const pair<int, double>& entry : sparseRows[i]) {
+                                const double * column = weights + (size_t) entry.first * k;
+                                for (int c = 0; c < k; c++) {
+                                    scores[c] += entry.second * relaxedLoad(column + c);
+                                }
+                            }
+                            double maxScore = *max_element(scores.begin(), scores.end());
+                            double total = 0.0;
+                            for (double& score : scores) {
+                                score = exp(score - maxScore);
+                                total += score;
+                            }
+                            for (int c = 0; c < k; c++) {
+                                scores[c] = (c == (int) Y(i, 0) - 1 ? 1.0 : 0.0) - scores[c] / total;
+                            }
+                            // This step's decay, then the gradient
+                            for (const pair<int, double>& entry : sparseRows[i]) {
+                                double factor = claimDecay(entry.first, step + 1, decay);
+                                double * column = weights + (size_t) entry.first * k;
+                                for (int c = 0; c < k; c++) {
+                                    relaxedStore(column + c, factor * relaxedLoad(column + c) + learningRate * entry.second * scores[c]);
+                                }
+                            }
+                        }
+                    }));
+                }
+                for (thread& worker : workers) {
+                    worker.join();
+                }
+                // Checkpoint: W is exact again
+                catchUpAllDecay(epochStart + m, decay);
+                chrono::steady_clock::time_point end = chrono::steady_clock::now();
+                reportEpoch(epoch, std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count(), reportLoss);
+            }
+        }
+
+        // Mean log loss of the training rows under the current weights, and their accuracy
+        double trainingLoss(double& accuracy) {
+            buildSparseRows();
+            double loss = 0.0;
+            int correct = 0;
+            VectorXd scores(k);
+            for (int i = 0; i < m; i++) {
+                scores.setZero();
+                for (const pair<int, double>& entry : sparseRows[i]) {
+                    scores += entry.second * W.col(entry.first);
+                }
+                int best;
+                double maxScore = scores.maxCoeff(&best);
+                double logTotal = maxScore + log((scores.array() - maxScore).exp().sum());
+                loss += logTotal - scores((int) Y(i, 0) - 1);
+                if (best + 1 == (int) Y(i, 0)) correct++;
+            }
+            accuracy = (double) correct / m;
+            return loss / m;
+        }
+
+        // Divide every column of W by the sum its column of X was divided by, so that scoring raw counts gives
+        // the scores training saw. Scoring otherwise applies the trained weights to raw counts as they are,
+        // which suits zero started models but not weights that start from Naive Bayes. Call once after training.
+        void scaleWeightsToCounts() {
+            for (int j = 0; j < n + 1; j++) {
+                if (columnSums(j) > 0) W.col(j) /= columnSums(j);
+            }
+        }
+
+        // Successive halving over every (learning rate, penalty term) pair with the full batch updates of train,
+        // all configurations sharing the loaded X. The survivors are split into numThreads groups that train
+        // concurrently, and the weights of a group are stacked into one (groupSize * k) x (n + 1) matrix so
+        // that an iteration is two products for the whole group. Rung r brings the survivors to
+        // maxItr / 2^(numRungs - 1 - r) iterations and scores them on the labelled validation file, and the
+        // better half goes on. There are at most floor(log2(maxItr)) + 1 rungs, so every rung trains longer than
+        // the one before, and the last rung may keep more than one configuration. Returns every configuration
+        // scored at every rung, each rung sorted best first.
+        vector<gridResult> gridSearch(const vector<double>& learningRates, const vector<double>& penaltyTerms, int maxItr,
+                                      const string& validationFile, int numThreads) {
+            vector<sparseDocument> documents;
+            vector<int> ids;
+            vector<int> labels;
+            if (!readSparseCsv(validationFile, (int) featureColumn.size(), documents, ids, labels)) throw runtime_error("Grid search needs a labelled validation file");
+            if (numThreads <= 0) numThreads = max(1, (int) thread::hardware_concurrency());
+
+            vector<gridResult> configs;
+            for (double rate : learningRates) {
+                for (double penalty : penaltyTerms) {
+                    configs.push_back({rate, penalty, 0, 0.0});
+                }
+            }
+            vector<MatrixXd> weights(configs.size(), MatrixXd::Zero(k, n + 1));
+            vector<int> alive(configs.size());
+            for (int c = 0; c < alive.size(); c++) {
+                alive[c] = c;
+            }
+            int numRungs = 1;
+            while ((1 << (numRungs - 1)) < (int) configs.size() && (1 << numRungs) <= maxItr) numRungs++;
+
+            vector<gridResult> results;
+            int done = 0;
+            for (int rung = 0; rung < numRungs && maxItr > 0; rung++) {
+                chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+                int budget = maxItr >> (numRungs - 1 - rung);
+                int numGroups = min(numThreads, (int) alive.size());
+                vector<thread> workers;
+                for (int t = 0; t < numGroups; t++) {
+                    workers.push_back(thread([&, t]() {
+                        int first = (int) ((long long) t * alive.size() / numGroups);
+                        int last = (int) ((long long) (t + 1) * alive.size() / numGroups);
+                        MatrixXd stacked(k * (last - first), n + 1);
+                        vector<double> rates;
+                        vector<double> penalties;
+                        for (int g = 0; g < last - first; g++) {
+                            int c = alive[first + g];
+                            stacked.middleRows(g * k, k) = weights[c];
+                            rates.push_back(configs[c].learningRate);
+                            penalties.push_back(configs[c].penaltyTerm);
+                        }
+                        trainStacked(stacked, rates, penalties, budget - done);
+                        vector<double> accuracy = stackedAccuracy(stacked, documents, labels);
+                        for (int g = 0; g < last - first; g++) {
+                            int c = alive[first + g];
+                            weights[c] = stacked.middleRows(g * k, k);
+                            configs[c].iterations = budget;
+                            configs[c].accuracy = accuracy[g];
+                        }
+                    }));
+                }
+                for (thread& worker : workers) {
+                    worker.join();
+                }
+                done = budget;
+
+                // Keep the better half
+                stable_sort(alive.begin(), alive.end(), [&](int a, int b) { return configs[a].accuracy > configs[b].accuracy; });
+                for (int c : alive) {
+                    results.push_back(configs[c]);
+                }
+                chrono::steady_clock::time_point end = chrono::steady_clock::now();
+                cout << "Rung " << rung << ": " << alive.size() << " configurations at " << budget << " iterations, best accuracy "
+                     << configs[alive[0]].accuracy * 100 << "%, " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << endl;
+                alive.resize((alive.size() + 1) / 2);
+            }
+            return results;
+        }
+
+        // Back to the zero weights of a new model
+        void resetWeights() {
+            W = MatrixXd::Zero(k, n + 1);
+        }
+
+        int predict(const Ref<const RowVectorXd>& features) {
             MatrixXd results = W * features.transpose();   // k x 1
             int maxIndex = 0;
             double maxValue = -std::numeric_limits<double>::infinity();
@@ -173,62 +690,116 @@ class logisticRegression{
             return maxIndex + 1;
         }
 
+        // Score a sparse document the way createTestX lays out a dense row: bias plus raw counts
+        VectorXd scores(const sparseDocument& document) {
+            VectorXd results = W.col(0);
+            for (const pair<int, int>& word : document) {
+                int column = featureColumn[word.first];
+                if (column >= 0) {
+                    results += word.second * W.col(column + 1);
+                }
+            }
+            return results;
+        }
+
+        int predict(const sparseDocument& document) {
+            if (pruningUpper.size() > 0) return predictPruned(document);
+            return predictFull(document);
+        }
+
+        // Score every class, whether pruning is enabled or not
+        int predictFull(const sparseDocument& document) {
+            int maxIndex;
+            scores(document).maxCoeff(&maxIndex);
+            return maxIndex + 1;
+        }
+
+        // Make predict eliminate classes that can no longer win instead of scoring all of them.
+        // Call after training, the bounds are taken from the current weights.
+        void enablePruning() {
+            columnBounds(W, pruningUpper, pruningLower);
+        }
+
+        // Same class as the full scorer, words are applied by decreasing weight spread until one class is left
+        int predictPruned(const sparseDocument& document) {
+            vector<pair<int, double>> terms;
+            for (const pair<int, int>& word : document) {
+                int column = featureColumn[word.first];
+                if (column >= 0) terms.push_back(make_pair(column + 1, (double) word.second));
+            }
+            vector<double> scores(W.col(0).data(), W.col(0).data() + k);
+            return prunedArgmax(W, pruningUpper, pruningLower, scores, terms) + 1;
+        }
+
+        // Softmax of the class scores
+        vector<double> posterior(const sparseDocument& document) {
+            VectorXd results = scores(document);
+            results = (results.array() - results.maxCoeff()).exp();
+            results /= results.sum();
+            return vector<double>(results.data(), results.data() + results.size());
+        }
+
+        // Number of vocabulary (or hashed) indices a sparse document may use
+        int numFeatures() {
+            return (int) featureColumn.size();
+        }
+
+        int numClasses() {
+            return k;
+        }
+
+        // Score a count file on every core. Rows are parsed straight into sparse documents, and results are
+        // written in file order to submission.csv, or counted against the last column for labelled files.
         void testModel(string file, bool produceSubmissionFile) {
-            chrono::steady_clock::time_point begin;
-            chrono::steady_clock::time_point end;
-            chrono::steady_clock::time_point begin1;
-            chrono::steady_clock::time_point end1;
-            begin = chrono::steady_clock::now();
-            vector<vector<int>> data = read_csv_int(file);
-            end = chrono::steady_clock::now();
-            std::cout << "Time to read file = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
-            begin = chrono::steady_clock::now();
-            if (produceSubmissionFile) {
-                data = seperateTargets(data, 0).first;
-                MatrixXd testMatrix = createTestX(data);  // convert to eigen matrix
+            scopedTimer timer("lr_test_model");
+            // Count csv files are streamed, sparse binary corpora written by generate.out are read at once
+            function<int(const sparseDocument&)> predictDocument = [this](const sparseDocument& document) { return predict(document); };
+            string submissionFile = produceSubmissionFile ? "submission.csv" : "";
+            pipelineStats stats = isSparseBinary(file)
+                                  ? scoreSparseBinary(file, (int) featureColumn.size(), !produceSubmissionFile, predictDocument, submissionFile)
+                                  : scoreCsvPipelined(file, (int) featureColumn.size(), !produceSubmissionFile, predictDocument, submissionFile, 12001);
+            printPipelineStats(stats);
 
-                // Crete submission file
+            if (!produceSubmissionFile) {
+                double correct = (double) stats.correct;
+                double total = (double) stats.rows;
+                ofstream record;
+                record.open("last_run_info.txt");
+                record << "Total: " << total << endl << "Correct: " << correct << endl << "Accuracy: " << (correct/total) * 100 << "%" << endl;
+                record.close();
+            }
+        }
+
+        // Classify raw text documents. Every line of the list file is a path, optionally followed by ",<class>".
+        void testDocuments(string file, bool produceSubmissionFile) {
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            perfectHashVocabulary lookup(vocab);
+            vector<vector<string>> documents = read_csv(file);
+            if (produceSubmissionFile) {
                 ofstream submission;
                 submission.open("submission.csv");
                 submission << "id,class" << endl;
-                begin1 = chrono::steady_clock::now();
-                for (int i = 0; i < data.size(); i++) {
-                    submission << 12001 + i << "," << predict(testMatrix.row(i)) << endl;
+                for (int i = 0; i < documents.size(); i++) {
+                    submission << 12001 + i << "," << predict(readDocument(documents.at(i).at(0), lookup)) << "\n";
                 }
-                end1 = chrono::steady_clock::now();
-                std::cout << "Time to predict = " << std::chrono::duration_cast<std::chrono::milliseconds>(end1 - begin1).count() << "[ms]" << std::endl;
                 submission.close();
             } else {
-                data = seperateTargets(data, 0).first;
-                vector<int> Y = seperateTargets(data, data.at(0).size() - 1).second;
-                data = seperateTargets(data, data.at(0).size() - 1).first;
-
-                MatrixXd testMatrix = createTestX(data);  // convert to eigen matrix
-
-                // Crete file to rec
-                ofstream record;
-                record.open("last_run_info.txt");
-
                 double correct = 0.0;
                 double total = 0.0;
-                int prediction;
-
-                for (int i = 0; i < Y.size(); i++) {
-                    prediction = predict(testMatrix.row(i));
-                    if (prediction == Y.at(i)) {
+                for (int i = 0; i < documents.size(); i++) {
+                    if (predict(readDocument(documents.at(i).at(0), lookup)) == stoi(documents.at(i).at(1))) {
                         correct = correct + 1.0;
-                        cout << prediction << " :)" << endl;
-                    } else {
-                        cout << prediction << " X" << endl;
                     }
                     total = total + 1.0;
                 }
 
+                ofstream record;
+                record.open("last_run_info.txt");
                 record << "Total: " << total << endl << "Correct: " << correct << endl << "Accuracy: " << (correct/total) * 100 << "%" << endl;
                 record.close();
             }
-            end = chrono::steady_clock::now();
-            std::cout << "Total time to predict classes = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;     
+            chrono::steady_clock::time_point end = chrono::steady_clock::now();
+            std::cout << "Total time to tokenize and predict = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
         }
 
         vector<vector<int>> getConfusionMatrix(int numClasses, string file){
@@ -250,9 +821,8 @@ class logisticRegression{
             end = chrono::steady_clock::now();
             std::cout << "Time to read file = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
             begin = chrono::steady_clock::now();
-            data = seperateTargets(data, 0).first;
-            vector<int> Y = seperateTargets(data, data.at(0).size() - 1).second;
-            data = seperateTargets(data, data.at(0).size() - 1).first;
+            stripColumn(data, 0);
+            vector<int> Y = stripColumn(data, data.at(0).size() - 1);
 
             MatrixXd testMatrix = createTestX(data);  // convert to eigen matrix
 
@@ -270,12 +840,20 @@ class logisticRegression{
 };
 
 int runLR(int argc, char** argv){
-    logisticRegression lr(argv[2], argv[3], argv[4], stod(argv[5]), stod(argv[6]), stoi(argv[7]));
+    if(argc < 8){
+        cerr << "Usage: " << argv[0] << " lr <dataMatrix.mtx> <vocab.txt> <labels.txt> <learningRate> <penaltyTerm> <numItr> [featureMask.vec]" << endl;
+        return 0;
+    }
+    vector<int> featureMask;
+    if (argc > 8) {
+        featureMask = read_vec_int(argv[8]);
+    }
+    logisticRegression lr(argv[2], argv[3], argv[4], stod(argv[5]), stod(argv[6]), stoi(argv[7]), featureMask);
     cout << "Train start" << endl;
     chrono::steady_clock::time_point begin = chrono::steady_clock::now();
     lr.train();
     chrono::steady_clock::time_point end = chrono::steady_clock::now();
-    std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::seconds>(end - begin).count() << "[s]" << std::endl;
+    std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
     
     // lr.testModel("../testing.csv", true);
 
@@ -286,4 +864,170 @@ int runLR(int argc, char** argv){
     // writeIntMatrixToFile(confMatrix, confMatrixFile);
     // confMatrixFile.close();
     return 0;
-}
\ No newline at end of file
+}
+
+int runLRSparse(int argc, char** argv){
+    if(argc < 9){
+        cerr << "Usage: " << argv[0] << " lrsparse <dataMatrix.mtx> <vocab.txt> <labels.txt> <learningRate> <penaltyTerm> <numEpochs> <batchSize>" << endl;
+        return 0;
+    }
+    logisticRegression lr(argv[2], argv[3], argv[4], stod(argv[5]), stod(argv[6]), stoi(argv[7]));
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    lr.trainSparse(max(1, stoi(argv[8])));
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    lr.testModel("customTest.csv", false);
+    return 0;
+}
+
+// Train the same model serially and with Hogwild and compare the per epoch loss, the time and the test accuracy
+int runLRHogwild(int argc, char** argv){
+    if(argc < 9){
+        cerr << "Usage: " << argv[0] << " lrhogwild <dataMatrix.mtx> <vocab.txt> <labels.txt> <learningRate> <penaltyTerm> <numEpochs> <numThreads>" << endl;
+        return 0;
+    }
+    logisticRegression lr(argv[2], argv[3], argv[4], stod(argv[5]), stod(argv[6]), stoi(argv[7]));
+    int numThreads = stoi(argv[8]);
+
+    std::cout << "Serial SGD" << std::endl;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    lr.trainSparse(1, true);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+    lr.testModel("customTest.csv", false);
+
+    lr.resetWeights();
+    std::cout << "Hogwild SGD" << std::endl;
+    begin = chrono::steady_clock::now();
+    lr.trainHogwild(numThreads, true);
+    end = chrono::steady_clock::now();
+    std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+    lr.testModel("customTest.csv", false);
+    return 0;
+}
+
+// Search learning rates and penalty terms with successive halving on customTest.csv, loading X once
+int runLRGrid(int argc, char** argv){
+    if(argc < 8){
+        cerr << "Usage: " << argv[0] << " lrgrid <dataMatrix.mtx> <vocab.txt> <labels.txt> <learningRate,learningRate,...> <penaltyTerm,penaltyTerm,...> <maxItr> [numThreads] [results.csv]" << endl;
+        return 0;
+    }
+    vector<double> grid[2];
+    for (int axis = 0; axis < 2; axis++) {
+        stringstream list(argv[5 + axis]);
+        string value;
+        while (getline(list, value, ',')) {
+            if (!value.empty()) grid[axis].push_back(stod(value));
+        }
+        if (grid[axis].empty()) throw runtime_error("No values to search");
+    }
+    int numThreads = argc > 8 ? atoi(argv[8]) : 0;
+    string resultsFile = argc > 9 ? argv[9] : "gridSearch.csv";
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    logisticRegression lr(argv[2], argv[3], argv[4], grid[0].at(0), grid[1].at(0), stoi(argv[7]));
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Time to load data = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    begin = chrono::steady_clock::now();
+    vector<gridResult> results = lr.gridSearch(grid[0], grid[1], stoi(argv[7]), "customTest.csv", numThreads);
+    end = chrono::steady_clock::now();
+    std::cout << "Time to search " << grid[0].size() * grid[1].size() << " configurations = "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    ofstream table;
+    table.open(resultsFile);
+    table << "learningRate,penaltyTerm,iterations,accuracy" << endl;
+    for (const gridResult& result : results) {
+        table << result.learningRate << "," << result.penaltyTerm << "," << result.iterations << "," << result.accuracy * 100 << endl;
+    }
+    table.close();
+    if (!results.empty()) {
+        // The last rung comes last and is sorted best first
+        int best = (int) results.size() - 1;
+        while (best > 0 && results[best - 1].iterations == results.back().iterations) best--;
+        std::cout << "Best: learning rate " << results[best].learningRate << ", penalty term " << results[best].penaltyTerm << ", " << results[best].iterations
+                  << " iterations, accuracy " << results[best].accuracy * 100 << "%" << std::endl;
+    }
+    return 0;
+}
+
+// Train from zero weights and from the Naive Bayes warm start and compare the training loss after every epoch.
+// Both models are tested with the weights scaled to raw counts, so they score documents the way they were trained.
+int runLRWarmStart(int argc, char** argv){
+    if(argc < 10){
+        cerr << "Usage: " << argv[0] << " lrwarm <dataMatrix.mtx> <vocab.txt> <labels.txt> <learningRate> <penaltyTerm> <numEpochs> <batchSize> <beta>" << endl;
+        return 0;
+    }
+    logisticRegression lr(argv[2], argv[3], argv[4], stod(argv[5]), stod(argv[6]), stoi(argv[7]));
+    int batchSize = max(1, stoi(argv[8]));
+    double beta = stod(argv[9]);
+
+    for (int warm = 0; warm < 2; warm++) {
+        lr.resetWeights();
+        if (warm) lr.warmStartFromNaiveBayes(beta);
+        double accuracy;
+        double loss = lr.trainingLoss(accuracy);
+        std::cout << (warm ? "Naive Bayes warm start" : "Zero start") << ": training loss " << loss << ", training accuracy " << accuracy * 100 << "%" << std::endl;
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        lr.trainSparse(batchSize, true);
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+        lr.scaleWeightsToCounts();
+        lr.testModel("customTest.csv", false);
+        std::cout << read_lines("last_run_info.txt").back() << std::endl; // Accuracy line of the run just tested
+    }
+    return 0;
+}
+
+int runLRHash(int argc, char** argv){
+    if(argc < 10){
+        cerr << "Usage: " << argv[0] << " lrhash <trainList.txt> <labels.txt> <documentList.txt> <bits> <signed|unsigned> <learningRate> <penaltyTerm> <numItr>" << endl;
+        return 0;
+    }
+    logisticRegression lr(argv[2], argv[3], stoi(argv[5]), strcmp(argv[6], "signed") == 0, stod(argv[7]), stod(argv[8]), stoi(argv[9]));
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    lr.train();
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    vector<vector<string>> documents = read_csv(argv[4]);
+    lr.testDocuments(argv[4], documents.empty() || documents.at(0).size() < 2);
+    return 0;
+}
+
+int runLRPrune(int argc, char** argv){
+    if(argc < 9){
+        cerr << "Usage: " << argv[0] << " lrprune <dataMatrix.mtx> <vocab.txt> <labels.txt> <learningRate> <penaltyTerm> <numItr> <labelledTest.csv>" << endl;
+        return 0;
+    }
+    logisticRegression lr(argv[2], argv[3], argv[4], stod(argv[5]), stod(argv[6]), stoi(argv[7]));
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    lr.train();
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    lr.enablePruning();
+    comparePrunedScoring(argv[8], lr.numFeatures(),
+                         [&lr](const sparseDocument& document) { return lr.predictFull(document); },
+                         [&lr](const sparseDocument& document) { return lr.predictPruned(document); });
+    return 0;
+}
+
+int runLRServe(int argc, char** argv){
+    if(argc < 9){
+        cerr << "Usage: " << argv[0] << " lrserve <dataMatrix.mtx> <vocab.txt> <labels.txt> <learningRate> <penaltyTerm> <numItr> <socketPath> [numThreads]" << endl;
+        return 0;
+    }
+    logisticRegression lr(argv[2], argv[3], argv[4], stod(argv[5]), stod(argv[6]), stoi(argv[7]));
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    lr.train();
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Time to train model = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    serveModel(argv[8], argc > 9 ? atoi(argv[9]) : 0, lr.numFeatures(), lr.numClasses(),
+               [&lr](const sparseDocument& document) { return lr.predict(document); },
+               [&lr](const sparseDocument& document) { return lr.posterior(document); });
+    return 0;
+}
@@ -13,6 +13,8 @@
 #include "pythonpp.h"
 #include "NaiveBayesClassifier.h"
 #include "logisticRegressionClassifier.h"
+#include "decisionTreeClassifier.h"
+#include "scoringServer.h"
 
 using namespace std;
 
@@ -21,10 +23,64 @@ int main(int argc, char** argv){
     if(strcmp(argv[1], "nb") == 0){
         return runNB(argc, argv);
     }
+    else if(strcmp(argv[1], "nbtext") == 0){
+        return runNBText(argc, argv);
+    }
+    else if(strcmp(argv[1], "nbstream") == 0){
+        return runNBStream(argc, argv);
+    }
+    else if(strcmp(argv[1], "nbhash") == 0){
+        return runNBHash(argc, argv);
+    }
+    else if(strcmp(argv[1], "nbquant") == 0){
+        return runNBQuant(argc, argv);
+    }
+    else if(strcmp(argv[1], "nbprune") == 0){
+        return runNBPrune(argc, argv);
+    }
+    else if(strcmp(argv[1], "nbserve") == 0){
+        return runNBServe(argc, argv);
+    }
+    else if(strcmp(argv[1], "nbsweep") == 0){
+        return runNBSweep(argc, argv);
+    }
+    else if(strcmp(argv[1], "nbcv") == 0){
+        return runNBCrossValidation(argc, argv);
+    }
+    else if(strcmp(argv[1], "nbbernoulli") == 0){
+        return runNBBernoulli(argc, argv);
+    }
     else if(strcmp(argv[1], "lr") == 0){
         return runLR(argc, argv);
     }
+    else if(strcmp(argv[1], "lrsparse") == 0){
+        return runLRSparse(argc, argv);
+    }
+    else if(strcmp(argv[1], "lrhogwild") == 0){
+        return runLRHogwild(argc, argv);
+    }
+    else if(strcmp(argv[1], "lrwarm") == 0){
+        return runLRWarmStart(argc, argv);
+    }
+    else if(strcmp(argv[1], "lrgrid") == 0){
+        return runLRGrid(argc, argv);
+    }
+    else if(strcmp(argv[1], "lrhash") == 0){
+        return runLRHash(argc, argv);
+    }
+    else if(strcmp(argv[1], "lrprune") == 0){
+        return runLRPrune(argc, argv);
+    }
+    else if(strcmp(argv[1], "lrserve") == 0){
+        return runLRServe(argc, argv);
+    }
+    else if(strcmp(argv[1], "loadgen") == 0){
+        return runLoadGenerator(argc, argv);
+    }
+    else if(strcmp(argv[1], "dt") == 0){
+        return runDT(argc, argv);
+    }
     else{
-        cerr << "Invalid classfier. Options are 'lr' or 'nb'" << endl;
+        cerr << "Invalid classfier. Options are 'lr', 'lrsparse', 'lrhogwild', 'lrwarm', 'lrgrid', 'lrhash', 'lrserve', 'lrprune', 'nb', 'nbtext', 'nbhash', 'nbstream', 'nbquant', 'nbprune', 'nbserve', 'nbsweep', 'nbcv', 'nbbernoulli', 'loadgen' or 'dt'" << endl;
     }    
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdlib.h>
+#include "countShard.h"
+
+using namespace std;
+
+// Merge the count shards written by "preprocess.out --shard" into the model files NaiveBayes loads
+int main(int argc, char** argv){
+    if(argc < 3){
+        cerr << "Usage: " << argv[0] << " <numThreads> <shard> [shard ...]" << endl;
+        return 0;
+    }
+    int numThreads = atoi(argv[1]);
+    vector<string> files(argv + 2, argv + argc);
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    countShard merged = mergeCountShardFiles(files, numThreads);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Merged " << files.size() << " shards, " << merged.numDocuments << " documents over " << merged.numWords << " words" << std::endl;
+    std::cout << "Time to read and merge shards = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+
+    begin = chrono::steady_clock::now();
+    writeModelFiles(merged);
+    end = chrono::steady_clock::now();
+    std::cout << "Time to write model files = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+    return 0;
+}
@@ -12,32 +12,121 @@
 #include<chrono>
 #include<array>
 #include "pythonpp.h"
+#include "profiler.h"
+#include "countShard.h"
+#include "scoringPipeline.h"
 
 
 using namespace std;
 
+// Aggregate every row of one partition of the training data into a count shard, merged later by merge.out
+int writeShard(int argc, char * argv[]){
+    if(argc < 6){
+        cerr << "Usage: " << argv[0] << " --shard <partition.csv> <vocabulary.txt> <groupLabels.txt> <output.shard>" << endl;
+        return 0;
+    }
+    scopedTimer total("preprocess_shard");
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    vector<vector<int>> data = read_csv_int((string) argv[2]);
+    stripColumn(data, 0);
+    vector<string> vocab = read_lines(argv[3]);
+    vector<string> label_vocab = read_lines(argv[4]);
+
+    countShard shard;
+    shard.vocabularyHash = vocabularyFingerprint(vocab, label_vocab);
+    shard.numClasses = label_vocab.size();
+    shard.numWords = vocab.size();
+    shard.numDocuments = data.size();
+    aggregateClassCounts(data, shard.numClasses, shard.numWords, shard.wordToClassCount, shard.wordToClassDocFreq, shard.rawCount, shard.classRepresentation);
+    writeCountShard(argv[5], shard);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Wrote shard of " << data.size() << " documents to " << argv[5] << std::endl;
+    std::cout << "Time to build shard = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+    return 0;
+}
+
+// Aggregate a sparse binary corpus written by generate.out into the Naive Bayes model files, or into a count
+// shard when an output file is given. Documents stay sparse, so this scales to vocabularies no dense csv row can hold.
+int aggregateSparseBinary(int argc, char * argv[]){
+    if(argc < 5){
+        cerr << "Usage: " << argv[0] << " --spc <training.spc> <vocabulary.txt> <groupLabels.txt> [output.shard]" << endl;
+        return 0;
+    }
+    scopedTimer total("preprocess_spc");
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    vector<string> vocab = read_lines(argv[3]);
+    vector<string> label_vocab = read_lines(argv[4]);
+    vector<sparseDocument> documents;
+    vector<int> ids;
+    vector<int> labels;
+    if(!readSparseBinary(argv[2], vocab.size(), documents, ids, labels)) throw runtime_error("Training corpus has no classes");
+
+    countShard shard;
+    shard.vocabularyHash = vocabularyFingerprint(vocab, label_vocab);
+    shard.numClasses = label_vocab.size();
+    shard.numWords = vocab.size();
+    shard.numDocuments = documents.size();
+    shard.wordToClassCount.assign(shard.numClasses, vector<int>(shard.numWords, 0));
+    shard.wordToClassDocFreq.assign(shard.numClasses, vector<int>(shard.numWords, 0));
+    shard.rawCount.assign(shard.numClasses, 0);
+    shard.classRepresentation.assign(shard.numClasses, 0);
+    for(int d=0; d<documents.size(); d++){
+        int i = labels[d] - 1;
+        if(i < 0 || i >= shard.numClasses) throw runtime_error("Class out of range in " + string(argv[2]));
+        shard.classRepresentation[i] += 1;
+        for(const pair<int, int>& word : documents[d]){
+            shard.wordToClassCount[i][word.first] += word.second;
+            shard.wordToClassDocFreq[i][word.first] += 1;
+            shard.rawCount[i] += word.second;
+        }
+    }
+    if(argc > 5) writeCountShard(argv[5], shard);
+    else writeModelFiles(shard);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Aggregated " << documents.size() << " documents over " << shard.numWords << " words" << std::endl;
+    std::cout << "Time to build model files = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+    return 0;
+}
+
 int main(int argc, char * argv[]){
 
+    if(argc > 1 && string(argv[1]) == "--shard"){
+        return writeShard(argc, argv);
+    }
+    if(argc > 1 && string(argv[1]) == "--spc"){
+        return aggregateSparseBinary(argc, argv);
+    }
     if(argc < 5){
-        cerr << "Usage: " << argv[0] << " <trainFile.csv> <vocabulary.txt> <groupLabels.txt> <trainSplitRatio>" << endl;
+        cerr << "Usage: " << argv[0] << " <trainFile.csv> <vocabulary.txt> <groupLabels.txt> <trainSplitRatio> [numFeatures] [chi|mi]" << endl;
+        cerr << "       " << argv[0] << " --shard <partition.csv> <vocabulary.txt> <groupLabels.txt> <output.shard>" << endl;
+        cerr << "       " << argv[0] << " --spc <training.spc> <vocabulary.txt> <groupLabels.txt> [output.shard]" << endl;
+        return 0;
+    }
+    // An empty feature mask means the whole vocabulary, so zero features cannot be asked for
+    if(argc > 5 && atoi(argv[5]) < 1){
+        cerr << "[numFeatures] must be at least 1, leave it out to keep every word" << endl;
         return 0;
     }
 
+    scopedTimer total("preprocess");
     cout << "Reading " << argv[1] << " ...." << endl;
     vector<vector<int>> data_initial;
     chrono::steady_clock::time_point begin = chrono::steady_clock::now();
     data_initial = read_csv_int((string) argv[1]);
     chrono::steady_clock::time_point end = chrono::steady_clock::now();
-    std::cout << "Time to read file = " << std::chrono::duration_cast<std::chrono::seconds>(end - begin).count() << "[s]" << std::endl;
+    std::cout << "Time to read file = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
 
     cout << "Preprocessing data ...." << endl;
-    vector<vector<int>> shuffledData = shuffleDataFrame(data_initial);
-    pair<vector<vector<int>>, vector<vector<int>>> train_test = train_test_split(shuffledData, atof(argv[4]));
+    {
+        scopedTimer timer("shuffle");
+        shuffleDataFrameInPlace(data_initial);
+    }
+    pair<vector<vector<int>>, vector<vector<int>>> train_test = train_test_split(move(data_initial), atof(argv[4]));
 
-    vector<vector<int>> data = train_test.first;
-    vector<vector<int>> test_data = train_test.second;
-    data = seperateTargets(data, 0).first; 
-    write_csv(test_data, "customTest.csv");
+    vector<vector<int>>& data = train_test.first;
+    stripColumn(data, 0);
+    write_csv(train_test.second, "customTest.csv");
+    train_test.second = vector<vector<int>>();
 
     vector<string> vocab;
     vocab = read_lines(argv[2]);
@@ -70,50 +159,72 @@ int main(int argc, char * argv[]){
     // File to store vector containing total word counts per class
     ofstream rawCountFile;
     rawCountFile.open("rawCount.vec");
-    vector<int> rawCount(number_of_classes, 0);
+    vector<int> rawCount;
 
     // File to store matrix of word to count frequencies
     ofstream wordToClassCountFile;
     wordToClassCountFile.open("wordToClassCount.mtx");
     vector<vector<int>> wordToClassCount;
 
-    for(int i=0; i<number_of_classes; i++){
-        vector<int> temp(number_of_unique_words, 0);
-        wordToClassCount.push_back(temp);
-    }
+    // File to store matrix of the number of documents of a class that contain a word, for the Bernoulli model
+    ofstream wordToClassDocFreqFile;
+    wordToClassDocFreqFile.open("wordToClassDocFreq.mtx");
+    vector<vector<int>> wordToClassDocFreq;
 
     // File to store vector containing total representation for each class
     ofstream classRepresentationFile;
     classRepresentationFile.open("classRepresentation.vec");
-    vector<int> classRepresentation(number_of_classes, 0);
-
-    int _class;
+    vector<int> classRepresentation;
 
     // Gather the data 
+    aggregateClassCounts(data, number_of_classes, number_of_unique_words, wordToClassCount, wordToClassDocFreq, rawCount, classRepresentation);
     for (int i = 0; i < data.size(); i++) {
-        _class = data.at(i).at((int) data.at(i).size() - 1);
-        classRepresentation.at(_class - 1) += 1;
-        for (int j = 0; j < data.at(i).size() - 1; j++) {
-            wordToClassCount.at(_class - 1).at(j) += data.at(i).at(j);
-            rawCount.at(_class - 1) += data.at(i).at(j);
-        }
-        deltaMatrix.at(_class - 1).at(i) = 1;
+        deltaMatrix.at(data.at(i).back() - 1).at(i) = 1;
     }
 
     // Write To File
-    writeIntVectorToFile(rawCount, rawCountFile);
-    writeIntVectorToFile(classRepresentation, classRepresentationFile);
-    writeIntMatrixToFile(wordToClassCount, wordToClassCountFile);
-    writeIntMatrixToFile(deltaMatrix, deltaMatrixFile);
-    writeIntMatrixToFile(data, dataMatrixFile);
+    {
+        scopedTimer timer("write_model_files");
+        writeIntVectorToFile(rawCount, rawCountFile);
+        writeIntVectorToFile(classRepresentation, classRepresentationFile);
+        writeIntMatrixToFile(wordToClassCount, wordToClassCountFile);
+        writeIntMatrixToFile(wordToClassDocFreq, wordToClassDocFreqFile);
+        writeIntMatrixToFile(deltaMatrix, deltaMatrixFile);
+        writeIntMatrixToFile(data, dataMatrixFile);
+    }
 
     // Close Files
     rawCountFile.close();
     wordToClassCountFile.close();
+    wordToClassDocFreqFile.close();
     classRepresentationFile.close();
     deltaMatrixFile.close();
     dataMatrixFile.close();
 
+    // Feature selection: keep the numFeatures words that depend most on the class
+    if (argc > 5) {
+        scopedTimer timer("feature_selection");
+        int numFeatures = atoi(argv[5]);
+        string scorer = argc > 6 ? argv[6] : "chi";
+        MatrixXd counts = dfToMatrixInt(wordToClassCount);
+        ArrayXd scores;
+        if (scorer.compare("mi") == 0) {
+            scores = mutualInformationFeatureScores(counts);
+        } else {
+            scores = chiSquaredFeatureScores(counts);
+            // Every word is tested on a 2 x k table
+            ArrayXd pValues = chiSquaredPValues(scores, ArrayXd::Constant(scores.size(), number_of_classes - 1));
+            cout << (pValues < 0.05).count() << " words depend on the class at 95% confidence" << endl;
+        }
+        vector<int> featureMask = topKFeatures(scores, numFeatures);
+        cout << "Selected " << featureMask.size() << " of " << number_of_unique_words << " words by " << scorer << endl;
+
+        ofstream featureMaskFile;
+        featureMaskFile.open("featureMask.vec");
+        writeIntVectorToFile(featureMask, featureMaskFile);
+        featureMaskFile.close();
+    }
+
     // //Write log probability matrix to a file
     // vector<vector<double>> logProbabilityMatrix;
 
@@ -0,0 +1,159 @@
+#include "profiler.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+// One finished phase, times in microseconds since the profiler started
+struct traceEvent {
+    const char * name;
+    long long start;
+    long long duration;
+    int thread;
+    long rssKb;
+};
+
+static mutex profileLock;
+static vector<traceEvent> events;
+static map<string, long long> counters;
+static chrono::steady_clock::time_point profileStart = chrono::steady_clock::now();
+static string reportFile;
+
+static bool enableFromEnvironment(){
+    const char * file = getenv("PROFILE_REPORT");
+    if(file == NULL || file[0] == '\0') return false;
+    reportFile = file;
+    atexit(writeProfileReport);
+    return true;
+}
+
+bool profilingEnabled = enableFromEnvironment();
+
+// Small stable id of the calling thread for the trace viewer
+static int threadNumber(){
+    static mutex numberLock;
+    static int nextNumber = 0;
+    thread_local int number = -1;
+    if(number < 0){
+        lock_guard<mutex> guard(numberLock);
+        number = nextNumber++;
+    }
+    return number;
+}
+
+// Counter deltas of one thread, merged into the global counters when the thread exits
+struct threadCounters {
+    unordered_map<const char *, long long> values;
+
+    void flush(){
+        if(values.empty()) return;
+        lock_guard<mutex> guard(profileLock);
+        for(const pair<const char * const, long long>& counter : values){
+            counters[counter.first] += counter.second;
+        }
+        values.clear();
+    }
+
+    ~threadCounters(){
+        flush();
+    }
+};
+
+static thread_local threadCounters localCounters;
+
+void profileCountSlow(const char * name, long long value){
+    localCounters.values[name] += value;
+}
+
+long peakRssKb(){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void scopedTimer::finish(){
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    traceEvent event;
+    event.name = phase;
+    event.start = chrono::duration_cast<chrono::microseconds>(begin - profileStart).count();
+    event.duration = chrono::duration_cast<chrono::microseconds>(end - begin).count();
+    event.thread = threadNumber();
+    event.rssKb = peakRssKb();
+    lock_guard<mutex> guard(profileLock);
+    events.push_back(event);
+}
+
+static void writeEscaped(ofstream& file, const string& text){
+    file << '"';
+    for(char c : text){
+        if(c == '"' || c == '\\') file << '\\';
+        file << c;
+    }
+    file << '"';
+}
+
+void writeProfileReport(){
+    // Counters of the main thread were merged by its thread_local destructor, which runs before exit handlers
+    if(!profilingEnabled) return;
+    lock_guard<mutex> guard(profileLock);
+
+    // Per phase totals
+    map<string, pair<long long, long long>> phases; // calls, total microseconds
+    for(const traceEvent& event : events){
+        pair<long long, long long>& phase = phases[event.name];
+        phase.first += 1;
+        phase.second += event.duration;
+    }
+
+    ofstream file;
+    file.open(reportFile);
+    if(!file.is_open()){
+        cerr << "Could not write profile report " << reportFile << endl;
+        return;
+    }
+    long long wall = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - profileStart).count();
+    file << "{" << endl;
+    file << "  \"wall_ms\": " << wall / 1000.0 << "," << endl;
+    file << "  \"peak_rss_kb\": " << peakRssKb() << "," << endl;
+
+    file << "  \"phases\": {";
+    bool first = true;
+    for(const pair<const string, pair<long long, long long>>& phase : phases){
+        file << (first ? "" : ",") << endl << "    ";
+        writeEscaped(file, phase.first);
+        file << ": {\"calls\": " << phase.second.first << ", \"total_ms\": " << phase.second.second / 1000.0 << "}";
+        first = false;
+    }
+    file << endl << "  }," << endl;
+
+    file << "  \"counters\": {";
+    first = true;
+    for(const pair<const string, long long>& counter : counters){
+        file << (first ? "" : ",") << endl << "    ";
+        writeEscaped(file, counter.first);
+        file << ": " << counter.second;
+        first = false;
+    }
+    file << endl << "  }," << endl;
+
+    // Chrome trace: one complete event per phase and the peak RSS as a counter track
+    file << "  \"traceEvents\": [";
+    first = true;
+    for(const traceEvent& event : events){
+        file << (first ? "" : ",") << endl << "    {\"name\": ";
+        writeEscaped(file, event.name);
+        file << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread << ", \"ts\": " << event.start << ", \"dur\": " << event.duration << "},";
+        file << endl << "    {\"name\": \"peak_rss_kb\", \"ph\": \"C\", \"pid\": 1, \"ts\": " << event.start + event.duration << ", \"args\": {\"kb\": " << event.rssKb << "}}";
+        first = false;
+    }
+    file << endl << "  ]" << endl << "}" << endl;
+    file.close();
+}
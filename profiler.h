@@ -0,0 +1,48 @@
+#ifndef H__PROFILER
+#define H__PROFILER
+
+#include <chrono>
+
+using namespace std;
+
+// Phase timers, counters and peak RSS for one run. Profiling is off unless the environment variable
+// PROFILE_REPORT names a file, then a single JSON report is written there when the process exits.
+// The report holds per phase totals, counters and peak RSS next to a "traceEvents" array, so the same
+// file also opens in chrome://tracing or Perfetto. When profiling is off every call is one branch.
+
+extern bool profilingEnabled;
+
+// Add value to a named counter (bytes parsed, rows, nonzeros, flops). Counts are buffered per thread
+// and merged when the thread exits or the report is written. name must be a string literal.
+void profileCountSlow(const char * name, long long value);
+
+inline void profileCount(const char * name, long long value) {
+    if (profilingEnabled) profileCountSlow(name, value);
+}
+
+// Time the enclosing scope as a phase. name must be a string literal.
+class scopedTimer {
+
+    public:
+        scopedTimer(const char * name) : phase(name) {
+            if (profilingEnabled) begin = chrono::steady_clock::now();
+        }
+
+        ~scopedTimer() {
+            if (profilingEnabled) finish();
+        }
+
+    private:
+        const char * phase;
+        chrono::steady_clock::time_point begin;
+
+        void finish();
+};
+
+// Peak resident set size of the process so far, in KB
+long peakRssKb();
+
+// Write the report to PROFILE_REPORT, registered to run at exit
+void writeProfileReport();
+
+#endif
@@ -0,0 +1,146 @@
+#include "prunedScoring.h"
+#include "scoringPipeline.h"
+#include "profiler.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdexcept> // runtime_error
+
+using namespace std;
+
+void columnBounds(const MatrixXd& table, VectorXd& upper, VectorXd& lower){
+    upper = table.colwise().maxCoeff().transpose();
+    lower = table.colwise().minCoeff().transpose();
+}
+
+int prunedArgmax(const MatrixXd& table, const VectorXd& upper, const VectorXd& lower,
+                 vector<double>& scores, vector<pair<int, double>>& terms){
+    int numClasses = (int) scores.size();
+    int numTerms = (int) terms.size();
+
+    // Largest swing first. Buffers are reused across calls, scoring runs once per document.
+    thread_local vector<pair<double, int>> order;
+    thread_local vector<pair<int, double>> sorted;
+    order.resize(numTerms);
+    for(int t=0; t<numTerms; t++){
+        order[t] = make_pair(-fabs(terms[t].second) * (upper[terms[t].first] - lower[terms[t].first]), t);
+    }
+    sort(order.begin(), order.end());
+    sorted.resize(numTerms);
+    for(int t=0; t<numTerms; t++){
+        sorted[t] = terms[order[t].second];
+    }
+    terms.swap(sorted);
+
+    // Most and least the terms from t on can still add to any class
+    thread_local vector<double> remainingHigh;
+    thread_local vector<double> remainingLow;
+    remainingHigh.assign(numTerms + 1, 0.0);
+    remainingLow.assign(numTerms + 1, 0.0);
+    for(int t=numTerms - 1; t>=0; t--){
+        double weight = terms[t].second;
+        double high = weight > 0 ? weight * upper[terms[t].first] : weight * lower[terms[t].first];
+        double low = weight > 0 ? weight * lower[terms[t].first] : weight * upper[terms[t].first];
+        remainingHigh[t] = remainingHigh[t + 1] + high;
+        remainingLow[t] = remainingLow[t + 1] + low;
+    }
+
+    thread_local vector<int> alive;
+    alive.resize(numClasses);
+    double best = -INFINITY;
+    double worst = INFINITY;
+    for(int i=0; i<numClasses; i++){
+        alive[i] = i;
+        best = max(best, scores[i]);
+        worst = min(worst, scores[i]);
+    }
+    int numAlive = numClasses;
+    long long updates = 0;
+    // Largest possible gap between the best and the worst survivor, a class can only be dropped once the
+    // gap exceeds the swing of the remaining terms, so the survivors are only rescanned when that is possible
+    double gapBound = best - worst;
+    for(int t=0; t<numTerms && numAlive > 1; t++){
+        const double * values = table.col(terms[t].first).data();
+        double weight = terms[t].second;
+        // While many classes survive a contiguous update of every class is cheaper than gathering the survivors
+        if(4 * numAlive > numClasses){
+            Map<VectorXd>(scores.data(), numClasses) += weight * table.col(terms[t].first);
+            updates += numClasses;
+        } else {
+            for(int a=0; a<numAlive; a++){
+                scores[alive[a]] += weight * values[alive[a]];
+            }
+            updates += numAlive;
+        }
+
+        double remainingSwing = remainingHigh[t + 1] - remainingLow[t + 1];
+        gapBound += (remainingHigh[t] - remainingLow[t]) - remainingSwing;
+        if(gapBound <= remainingSwing) continue;
+
+        best = -INFINITY;
+        worst = INFINITY;
+        for(int a=0; a<numAlive; a++){
+            best = max(best, scores[alive[a]]);
+            worst = min(worst, scores[alive[a]]);
+        }
+        gapBound = best - worst;
+        // The margin absorbs rounding, the survivors are summed in a different order than a full scorer would
+        double threshold = best + remainingLow[t + 1] - 1e-9 * (fabs(best) + remainingSwing + 1.0);
+        if(worst + remainingHigh[t + 1] >= threshold) continue;
+        int kept = 0;
+        for(int a=0; a<numAlive; a++){
+            if(scores[alive[a]] + remainingHigh[t + 1] >= threshold) alive[kept++] = alive[a];
+        }
+        numAlive = kept;
+    }
+    profileCount("pruned_class_updates", updates);
+    profileCount("pruned_full_updates", (long long) numTerms * numClasses);
+
+    int winner = alive[0];
+    for(int a=0; a<numAlive; a++){
+        if(scores[alive[a]] > scores[winner]) winner = alive[a];
+    }
+    return winner;
+}
+
+void comparePrunedScoring(const string& file, int numFeatures, const function<int(const sparseDocument&)>& full,
+                          const function<int(const sparseDocument&)>& pruned){
+    vector<sparseDocument> documents;
+    vector<int> ids;
+    vector<int> labels;
+    if(!readSparseCsv(file, numFeatures, documents, ids, labels)) throw runtime_error("Comparing scorers needs a labelled file");
+
+    vector<int> exact(documents.size());
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for(int i=0; i<documents.size(); i++){
+        exact[i] = full(documents[i]);
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    std::cout << "Time to predict with every class = " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << "[us]" << std::endl;
+
+    vector<int> fast(documents.size());
+    begin = chrono::steady_clock::now();
+    for(int i=0; i<documents.size(); i++){
+        fast[i] = pruned(documents[i]);
+    }
+    end = chrono::steady_clock::now();
+    std::cout << "Time to predict with class elimination = " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << "[us]" << std::endl;
+
+    double agree = 0.0;
+    double correct = 0.0;
+    double total = 0.0;
+    for(int i=0; i<documents.size(); i++){
+        if(fast[i] == exact[i]) agree = agree + 1.0;
+        if(fast[i] == labels[i]) correct = correct + 1.0;
+        total = total + 1.0;
+    }
+    std::cout << "Agreement with full scoring = " << (agree/total) * 100 << "%" << std::endl;
+
+    ofstream record;
+    record.open("last_run_info.txt");
+    record << "Total: " << total << endl << "Correct: " << correct << endl << "Accuracy: " << (correct/total) * 100 << "%" << endl;
+    record << "Agreement: " << (agree/total) * 100 << "%" << endl;
+    record.close();
+}
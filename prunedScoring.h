@@ -0,0 +1,32 @@
+#ifndef H__PRUNED_SCORING
+#define H__PRUNED_SCORING
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <Eigen/Dense>
+#include "tokenizer.h"
+
+using namespace std;
+using namespace Eigen;
+
+// Exact argmax of linear class scores with early class elimination. A class score is its base score plus
+// the sum over the document terms of weight * table(class, column). Terms are applied in descending order of
+// the largest swing they can cause, and after each term every class whose score plus the most its remaining
+// terms can add falls below the best score plus the least they can add is dropped. Scoring stops as soon
+// as one class is left, so with many classes most terms only touch a few survivors, or none at all.
+
+// Largest and smallest value of every column of a classes x columns table, the bounds prunedArgmax needs
+void columnBounds(const MatrixXd& table, VectorXd& upper, VectorXd& lower);
+
+// Index of the best class. scores holds the base score of every class on entry and is overwritten, terms
+// are (table column, weight) pairs and are reordered. Ties go to the lowest index as with a full argmax.
+int prunedArgmax(const MatrixXd& table, const VectorXd& upper, const VectorXd& lower,
+                 vector<double>& scores, vector<pair<int, double>>& terms);
+
+// Score a labelled count file with the full and the pruned scorer, report the time of both and their
+// agreement, and write the accuracy of the pruned scorer to last_run_info.txt
+void comparePrunedScoring(const string& file, int numFeatures, const function<int(const sparseDocument&)>& full,
+                          const function<int(const sparseDocument&)>& pruned);
+
+#endif
@@ -12,13 +12,16 @@
 #include <stdlib.h>
 #include <set>
 #include <math.h>
+#include <float.h>
 #include <unordered_map>
+#include <mutex>
 #include "chisqr.h"
 #include "gamma.h"
+#include "profiler.h"
 
 using namespace std;
 
-vector<vector<string>> read_csv(string filename){ //From https://www.gormanalysis.com/blog/reading-and-writing-csv-files-with-cpp/
+vector<vector<string>> read_csv(const string& filename){ //From https://www.gormanalysis.com/blog/reading-and-writing-csv-files-with-cpp/
     vector<vector<string>> result;
     ifstream myFile(filename); // Create an input filestream
     if(!myFile.is_open()) throw runtime_error("Could not open file"); // Make sure the file is open
@@ -39,7 +42,8 @@ vector<vector<string>> read_csv(string filename){ //From https://www.gormanalysi
 }
 
 //Read a csv file and interpret all values as integers. Much more memory efficient than reading in strings.
-vector<vector<int>> read_csv_int(string filename){
+vector<vector<int>> read_csv_int(const string& filename){
+    scopedTimer timer("read_csv_int");
     vector<vector<int>> result;
     ifstream myFile(filename); // Create an input filestream
     if(!myFile.is_open()) throw runtime_error("Could not open file"); // Make sure the file is open
@@ -47,6 +51,8 @@ vector<vector<int>> read_csv_int(string filename){
     if(myFile.good())
     {
         while(getline(myFile, line)){ // Extract the first line in the file
+            profileCount("bytes_parsed", (long long) line.size() + 1);
+            profileCount("rows_parsed", 1);
             vector<int> row;
             stringstream ss(line); // Create a stringstream from line
             while(getline(ss, attribute, ',')){ // Extract each column name
@@ -60,7 +66,8 @@ vector<vector<int>> read_csv_int(string filename){
 }
 
 //Read a csv file and interpret all values as integers. Much more memory efficient than reading in strings. Return pointer
-vector<vector<int>> * read_csv_int_p(string filename){
+vector<vector<int>> * read_csv_int_p(const string& filename){
+    scopedTimer timer("read_csv_int");
     vector<vector<int>> * result = new vector<vector<int>>;
     ifstream myFile(filename); // Create an input filestream
     if(!myFile.is_open()) throw runtime_error("Could not open file"); // Make sure the file is open
@@ -68,6 +75,8 @@ vector<vector<int>> * read_csv_int_p(string filename){
     if(myFile.good())
     {
         while(getline(myFile, line)){ // Extract the first line in the file
+            profileCount("bytes_parsed", (long long) line.size() + 1);
+            profileCount("rows_parsed", 1);
             vector<int> row;
             stringstream ss(line); // Create a stringstream from line
             while(getline(ss, attribute, ',')){ // Extract each column name
@@ -81,7 +90,7 @@ vector<vector<int>> * read_csv_int_p(string filename){
 }
 
 //Read a csv file and interpret all values as integers. Much more memory efficient than reading in strings.
-vector<vector<double>> read_csv_double(string filename){
+vector<vector<double>> read_csv_double(const string& filename){
     vector<vector<double>> result;
     ifstream myFile(filename); // Create an input filestream
     if(!myFile.is_open()) throw runtime_error("Could not open file"); // Make sure the file is open
@@ -102,7 +111,7 @@ vector<vector<double>> read_csv_double(string filename){
 }
 
 //read lines from any file
-vector<string> read_lines(string filename){
+vector<string> read_lines(const string& filename){
     vector<string> result;
     ifstream myFile(filename); // Create an input filestream
     if(!myFile.is_open()) throw runtime_error("Could not open file"); // Make sure the file is open
@@ -117,20 +126,16 @@ vector<string> read_lines(string filename){
     return result;
 }
 
-vector<int> read_vec_int(string filename){
-    vector<int> result;
-    result = read_csv_int(filename).at(0);
-    return result;
+vector<int> read_vec_int(const string& filename){
+    return move(read_csv_int(filename).at(0));
 }
 
-vector<double> read_vec_double(string filename){
-    vector<double> result;
-    result = read_csv_double(filename).at(0);
-    return result;
+vector<double> read_vec_double(const string& filename){
+    return move(read_csv_double(filename).at(0));
 }   
 
 //Write an integer vector to a file
-void writeIntVectorToFile(vector<int> arr, ofstream& file) {
+void writeIntVectorToFile(const vector<int>& arr, ofstream& file) {
     for (int i = 0; i < arr.size(); i++) {
         if (i < arr.size() - 1) {
             file << arr[i] << ",";
@@ -142,15 +147,15 @@ void writeIntVectorToFile(vector<int> arr, ofstream& file) {
 }
 
 //Write an integer matrix to a file
-void writeIntMatrixToFile(vector<vector<int>> arr, ofstream& file) {
-    for(vector<int> item : arr){
+void writeIntMatrixToFile(const vector<vector<int>>& arr, ofstream& file) {
+    for(const vector<int>& item : arr){
         writeIntVectorToFile(item, file);
         file << endl;
     }
 }
 
 //Write an Double vector to a file
-void writeDoubleVectorToFile(vector<double> arr, ofstream& file) {
+void writeDoubleVectorToFile(const vector<double>& arr, ofstream& file) {
     for (int i = 0; i < arr.size(); i++) {
         if (i < arr.size() - 1) {
             file << arr[i] << ",";
@@ -162,15 +167,15 @@ void writeDoubleVectorToFile(vector<double> arr, ofstream& file) {
 }
 
 //Write an double matrix to a file
-void writeDoubleMatrixToFile(vector<vector<double>> arr, ofstream& file) {
-    for(vector<double> item : arr){
+void writeDoubleMatrixToFile(const vector<vector<double>>& arr, ofstream& file) {
+    for(const vector<double>& item : arr){
         writeDoubleVectorToFile(item, file);
         file << endl;
     }
 }
 
 //Write a 2d vector to a csv file
-void write_csv(vector<vector<int>> input, string filename){
+void write_csv(const vector<vector<int>>& input, const string& filename){
     ofstream file1;
     file1.open(filename);
     for(int i=0; i<input.size(); i++){
@@ -186,7 +191,7 @@ void write_csv(vector<vector<int>> input, string filename){
 }
 
 //Convert 2d vector to eigen matrix
-MatrixXd dfToMatrixInt(vector<vector<int>> data){
+MatrixXd dfToMatrixInt(const vector<vector<int>>& data){
     MatrixXd result((int) data.size(), (int) data.at(0).size());
     for(int i=0; i< data.size(); i++){
         for(int j=0; j<data.at(i).size(); j++){
@@ -197,7 +202,7 @@ MatrixXd dfToMatrixInt(vector<vector<int>> data){
 }
 
 //Write a 2d vector to a csv file
-void write_csv(vector<vector<double>> input, string filename){
+void write_csv(const vector<vector<double>>& input, const string& filename){
     ofstream file1;
     file1.open(filename);
     for(int i=0; i<input.size(); i++){
@@ -213,7 +218,7 @@ void write_csv(vector<vector<double>> input, string filename){
 }
 
 //Write a 2d vector to a csv file
-void write_csv(vector<vector<string>> input, string filename){
+void write_csv(const vector<vector<string>>& input, const string& filename){
     ofstream file1;
     file1.open(filename);
     for(int i=0; i<input.size(); i++){
@@ -229,7 +234,7 @@ void write_csv(vector<vector<string>> input, string filename){
 }
 
 //Return dictionary that maps the input vector of strings to indices based on their order
-unordered_map<string, int> make_dict(vector<string> vocab){
+unordered_map<string, int> make_dict(const vector<string>& vocab){
     unordered_map<string, int> result;
     for(int i=0; i<vocab.size(); i++){
         result[vocab[i]] = i;
@@ -238,7 +243,7 @@ unordered_map<string, int> make_dict(vector<string> vocab){
 }
 
 //Return dictionary that maps the input vector of strings to indices based on their order with an added offset
-unordered_map<string, int> make_dict(vector<string> vocab, int offset){
+unordered_map<string, int> make_dict(const vector<string>& vocab, int offset){
     unordered_map<string, int> result;
     for(int i=0; i<vocab.size(); i++){
         result[vocab[i]] = i+offset;
@@ -247,7 +252,7 @@ unordered_map<string, int> make_dict(vector<string> vocab, int offset){
 }
 
 //Print 2 dimensional dataframe
-void printDataFrame(vector<vector<string>> data){
+void printDataFrame(const vector<vector<string>>& data){
     for(int i=0; i<data.size(); i++){
         for(int j=0; j<data.at(i).size(); j++){
             cout << data.at(i).at(j) << " ";
@@ -258,7 +263,7 @@ void printDataFrame(vector<vector<string>> data){
 }
 
 //Print 1 dimensional row/column
-void printColumns(vector<string> data){
+void printColumns(const vector<string>& data){
     for(int i=0; i<data.size(); i++){
         cout << data.at(i) << " ";
     }
@@ -266,11 +271,14 @@ void printColumns(vector<string> data){
 }
 
 //Separate attributes from target and return as a pair
-pair<vector<vector<string>>, vector<string>> seperateTargets(vector<vector<string>> data, int targetIndex){
+pair<vector<vector<string>>, vector<string>> seperateTargets(const vector<vector<string>>& data, int targetIndex){
     pair<vector<vector<string>>, vector<string>> result;
     vector<string> targets;
+    targets.reserve(data.size());
+    result.first.reserve(data.size());
     for(int i=0; i<data.size(); i++){
         vector<string> row;
+        row.reserve(data.at(i).size());
         for(int j=0; j<data.at(i).size(); j++){
             if(j == targetIndex){
                 targets.push_back(data.at(i).at(j));
@@ -279,18 +287,21 @@ pair<vector<vector<string>>, vector<string>> seperateTargets(vector<vector<strin
                 row.push_back(data.at(i).at(j));
             }
         }
-        result.first.push_back(row);
+        result.first.push_back(move(row));
     }
-    result.second = targets;
+    result.second = move(targets);
     return result;
 }
 
 //Separate attributes from target and return as a pair
-pair<vector<vector<int>>, vector<int>> seperateTargets(vector<vector<int>> data, int targetIndex){
+pair<vector<vector<int>>, vector<int>> seperateTargets(const vector<vector<int>>& data, int targetIndex){
     pair<vector<vector<int>>, vector<int>> result;
     vector<int> targets;
+    targets.reserve(data.size());
+    result.first.reserve(data.size());
     for(int i=0; i<data.size(); i++){
         vector<int> row;
+        row.reserve(data.at(i).size());
         for(int j=0; j<data.at(i).size(); j++){
             if(j == targetIndex){
                 targets.push_back(data.at(i).at(j));
@@ -299,14 +310,58 @@ pair<vector<vector<int>>, vector<int>> seperateTargets(vector<vector<int>> data,
                 row.push_back(data.at(i).at(j));
             }
         }
-        result.first.push_back(row);
+        result.first.push_back(move(row));
+    }
+    result.second = move(targets);
+    return result;
+}
+
+//Remove a column from every row in place and return its values
+vector<string> stripColumn(vector<vector<string>>& data, int column){
+    vector<string> result;
+    result.reserve(data.size());
+    for(int i=0; i<data.size(); i++){
+        result.push_back(move(data[i][column]));
+        data[i].erase(data[i].begin() + column);
     }
-    result.second = targets;
     return result;
 }
 
+//Remove a column from every row in place and return its values
+vector<int> stripColumn(vector<vector<int>>& data, int column){
+    vector<int> result;
+    result.reserve(data.size());
+    for(int i=0; i<data.size(); i++){
+        result.push_back(data[i][column]);
+        data[i].erase(data[i].begin() + column);
+    }
+    return result;
+}
+
+//Sum word counts, word document frequencies and document counts per class over training rows laid out as <counts...>,<class>. Classes start at 1.
+void aggregateClassCounts(const vector<vector<int>>& data, int numClasses, int numWords, vector<vector<int>>& wordToClassCount, vector<vector<int>>& wordToClassDocFreq, vector<int>& rawCount, vector<int>& classRepresentation){
+    scopedTimer timer("aggregate_class_counts");
+    wordToClassCount.assign(numClasses, vector<int>(numWords, 0));
+    wordToClassDocFreq.assign(numClasses, vector<int>(numWords, 0));
+    rawCount.assign(numClasses, 0);
+    classRepresentation.assign(numClasses, 0);
+    for(int i=0; i<data.size(); i++){
+        int _class = data[i].back() - 1;
+        classRepresentation.at(_class) += 1;
+        vector<int>& counts = wordToClassCount.at(_class);
+        vector<int>& docFreq = wordToClassDocFreq.at(_class);
+        int total = 0;
+        for(int j=0; j<(int) data[i].size() - 1; j++){
+            counts[j] += data[i][j];
+            docFreq[j] += data[i][j] != 0;
+            total += data[i][j];
+        }
+        rawCount.at(_class) += total;
+    }
+}
+
 //Separate column headers and return as a pair
-pair<vector<string>, vector<vector<string>>> seperateHeader(vector<vector<string>> data){
+pair<vector<string>, vector<vector<string>>> seperateHeader(const vector<vector<string>>& data){
     pair<vector<string>, vector<vector<string>>> result;
     for(int i=0; i<data.size(); i++){
         vector<string> row;
@@ -324,7 +379,7 @@ pair<vector<string>, vector<vector<string>>> seperateHeader(vector<vector<string
 }
 
 //Separate column headers and return as a pair
-pair<vector<int>, vector<vector<int>>> seperateHeader(vector<vector<int>> data){
+pair<vector<int>, vector<vector<int>>> seperateHeader(const vector<vector<int>>& data){
     pair<vector<int>, vector<vector<int>>> result;
     for(int i=0; i<data.size(); i++){
         vector<int> row;
@@ -341,14 +396,26 @@ pair<vector<int>, vector<vector<int>>> seperateHeader(vector<vector<int>> data){
     return result;
 }
 
-//Shuffle dataframe
+//Shuffle dataframe in place
+void shuffleDataFrameInPlace(vector<vector<string>>& data){
+    auto rng = default_random_engine {};
+    shuffle(data.begin(), data.end(), rng);
+}
+
+//Shuffle dataframe in place
+void shuffleDataFrameInPlace(vector<vector<int>>& data){
+    auto rng = default_random_engine {};
+    shuffle(data.begin(), data.end(), rng);
+}
+
+//Shuffle dataframe. Takes ownership of its input, pass with move() to avoid a copy
 vector<vector<string>> shuffleDataFrame(vector<vector<string>> data){
     auto rng = default_random_engine {};
     shuffle(data.begin(), data.end(), rng);
     return data;
 }
 
-//Shuffle dataframe
+//Shuffle dataframe. Takes ownership of its input, pass with move() to avoid a copy
 vector<vector<int>> shuffleDataFrame(vector<vector<int>> data){
     auto rng = default_random_engine {};
     shuffle(data.begin(), data.end(), rng);
@@ -357,7 +424,7 @@ vector<vector<int>> shuffleDataFrame(vector<vector<int>> data){
 
 
 //Split dataframe into train and test based on trainRatio(between 0 and 1)
-pair<vector<vector<string>>, vector<vector<string>>> train_test_split(vector<vector<string>> data, float trainRatio){
+pair<vector<vector<string>>, vector<vector<string>>> train_test_split(const vector<vector<string>>& data, float trainRatio){
     pair<vector<vector<string>>, vector<vector<string>>> result;
     int lastTrainIdx = (int) (trainRatio * (float) data.size());
     for(int i=0; i<data.size(); i++){
@@ -372,7 +439,7 @@ pair<vector<vector<string>>, vector<vector<string>>> train_test_split(vector<vec
 }
 
 //Split dataframe into train and test based on trainRatio(between 0 and 1)
-pair<vector<vector<int>>, vector<vector<int>>> train_test_split(vector<vector<int>> data, float trainRatio){
+pair<vector<vector<int>>, vector<vector<int>>> train_test_split(const vector<vector<int>>& data, float trainRatio){
     pair<vector<vector<int>>, vector<vector<int>>> result;
     int lastTrainIdx = (int) (trainRatio * (float) data.size());
     for(int i=0; i<data.size(); i++){
@@ -386,8 +453,28 @@ pair<vector<vector<int>>, vector<vector<int>>> train_test_split(vector<vector<in
     return result;
 }
 
+//Split dataframe into train and test based on trainRatio(between 0 and 1), moving the rows instead of copying them
+pair<vector<vector<string>>, vector<vector<string>>> train_test_split(vector<vector<string>>&& data, float trainRatio){
+    pair<vector<vector<string>>, vector<vector<string>>> result;
+    int lastTrainIdx = (int) (trainRatio * (float) data.size());
+    result.second.assign(make_move_iterator(data.begin() + lastTrainIdx), make_move_iterator(data.end()));
+    data.resize(lastTrainIdx);
+    result.first = move(data);
+    return result;
+}
+
+//Split dataframe into train and test based on trainRatio(between 0 and 1), moving the rows instead of copying them
+pair<vector<vector<int>>, vector<vector<int>>> train_test_split(vector<vector<int>>&& data, float trainRatio){
+    pair<vector<vector<int>>, vector<vector<int>>> result;
+    int lastTrainIdx = (int) (trainRatio * (float) data.size());
+    result.second.assign(make_move_iterator(data.begin() + lastTrainIdx), make_move_iterator(data.end()));
+    data.resize(lastTrainIdx);
+    result.first = move(data);
+    return result;
+}
+
 // get unique values of all attribute choices 
-vector<string> getUniqueAttributes(vector<vector<string>> data, int attribute){
+vector<string> getUniqueAttributes(const vector<vector<string>>& data, int attribute){
     vector<string> result;
     set<string> attr_set;
     for(int i=0; i<data.size(); i++){
@@ -398,7 +485,7 @@ vector<string> getUniqueAttributes(vector<vector<string>> data, int attribute){
 }
 
 // cut out attribute column, and return k subsets based on k choices for said attribute
-vector<vector<vector<string>>> attribute_based_split(vector<vector<string>> data, int attribute, vector<string> values){
+vector<vector<vector<string>>> attribute_based_split(const vector<vector<string>>& data, int attribute, const vector<string>& values){
     vector<vector<vector<string>>> result;
     for(int i=0; i<values.size(); i++){
         result.push_back(vector<vector<string>> {});
@@ -414,7 +501,7 @@ vector<vector<vector<string>>> attribute_based_split(vector<vector<string>> data
 }
 
 //Returns singular pair of subdataset and attribute label based on the value passed in
-pair<string, vector<vector<string>>> attribute_based_split_labelled(vector<vector<string>> data, int attribute, string value){
+pair<string, vector<vector<string>>> attribute_based_split_labelled(const vector<vector<string>>& data, int attribute, const string& value){
     pair<string, vector<vector<string>>> result;
     result.first = value;
     result.second = vector<vector<string>>{};
@@ -427,7 +514,7 @@ pair<string, vector<vector<string>>> attribute_based_split_labelled(vector<vecto
 }
 
 //Returns all pairs of subdatasets based on all possible values of the attribute passed in.
-vector<pair<string, vector<vector<string>>>> attribute_based_split_labelled_all(vector<vector<string>> data, int attribute){
+vector<pair<string, vector<vector<string>>>> attribute_based_split_labelled_all(const vector<vector<string>>& data, int attribute){
     vector<pair<string, vector<vector<string>>>> result;
     vector<string> values = getUniqueAttributes(data, attribute);
     vector<vector<vector<string>>> all_subdatasets = attribute_based_split(data, attribute, values);
@@ -446,7 +533,7 @@ vector<pair<string, vector<vector<string>>>> attribute_based_split_labelled_all(
 }
 
 // return sub-datasets, each containing homogeneous values for the chosen attribute
-vector<vector<vector<string>>> attribute_based_filter(vector<vector<string>> data, int attribute){
+vector<vector<vector<string>>> attribute_based_filter(const vector<vector<string>>& data, int attribute){
     vector<vector<vector<string>>> result;
     vector<string> uniqueValues = getUniqueAttributes(data, attribute);
     for(int i=0; i<uniqueValues.size(); i++){
@@ -463,7 +550,7 @@ vector<vector<vector<string>>> attribute_based_filter(vector<vector<string>> dat
 }
 
 // Get the misclassification error for a dataset, given the attribute's column id, and target's column id
-double getMisclassificationError(vector<vector<string>> data, int target){
+double getMisclassificationError(const vector<vector<string>>& data, int target){
     vector<string> unq_targets = getUniqueAttributes(data, target);
     vector<double> counts;
     vector<double> probabilities;
@@ -486,7 +573,7 @@ double getMisclassificationError(vector<vector<string>> data, int target){
 }
 
 // Get the entropy measure for a dataset, given the attribute's column id, and target's column id
-double getEntropy(vector<vector<string>> data, int target){
+double getEntropy(const vector<vector<string>>& data, int target){
     vector<string> unq_targets = getUniqueAttributes(data, target);
     vector<double> counts;
     vector<double> probabilities;
@@ -512,7 +599,7 @@ double getEntropy(vector<vector<string>> data, int target){
 }
 
 // Get the Gini index for a dataset, given the attribute's column id, and target's column id
-double getGini(vector<vector<string>> data, int target){
+double getGini(const vector<vector<string>>& data, int target){
     vector<string> unq_targets = getUniqueAttributes(data, target);
     vector<double> counts;
     vector<double> probabilities;
@@ -539,7 +626,7 @@ double getGini(vector<vector<string>> data, int target){
 }
 
 // Get the information gain for a dataset, given the attribute's column id, target's column id, and split criterion (gini or entropy)
-double getGain(vector<vector<string>> data, string criterion, int attribute, int target){
+double getGain(const vector<vector<string>>& data, const string& criterion, int attribute, int target){
     double result;
     int data_length = data.size();
     vector<string> classes = getUniqueAttributes(data, target);
@@ -588,7 +675,7 @@ double getGain(vector<vector<string>> data, string criterion, int attribute, int
 }
 
 //Returns child's index with maximum information gain
-int getMaxGainIndex(vector<vector<string>> data, string criterion, int target){
+int getMaxGainIndex(const vector<vector<string>>& data, const string& criterion, int target){
     vector<double> gains;
     for(int i=0; i<data.at(0).size(); i++){
         if(i != target){
@@ -600,7 +687,7 @@ int getMaxGainIndex(vector<vector<string>> data, string criterion, int target){
 }
 
 //Return number of instances for each value in an attribute/target
-vector<pair<string, int>> getValueInstances(vector<vector<string>> data, int attribute){
+vector<pair<string, int>> getValueInstances(const vector<vector<string>>& data, int attribute){
     vector<pair<string, int>> result;
     vector<string> unqValues = getUniqueAttributes(data, attribute);
     for(int i=0; i<unqValues.size(); i++){
@@ -625,188 +712,264 @@ double chiSquaredLookup(double degreeFreedom, double alpha){
     return lookupValue;
 }
 
-// //Computes X^2 value for the chosen split attribute
-// double chiSquaredValue(vector<vector<string>> parentData, int attribute, int target){
-//     vector<string> classes = getUniqueAttributes(parentData, target);
-//     vector<string> unqValues = getUniqueAttributes(parentData, attribute);
-//     int numClasses = classes.size();
-//     int numValues = unqValues.size();
-//     vector<pair<string, int>> classCountParent;
-//     //Count class instances in the parent node
-//     for(int i=0; i<classes.size(); i++){
-//         pair<string, int> temp;
-//         temp.first = classes.at(i);
-//         temp.second = 0;
-//         classCountParent.push_back(temp);
-//     }
-//     for(int i=0; i<parentData.size(); i++){
-//         for(int j=0; j<classCountParent.size(); j++){
-//             if(parentData.at(i).at(target).compare(classCountParent.at(j).first) == 0){
-//                 classCountParent.at(j).second = classCountParent.at(j).second + 1;
-//             }
-//         }
-//     }
-//     //Store real counts and expected counts for each child node
-//     vector<pair<string, vector<vector<string>>>> splitData_all = attribute_based_split_labelled_all(parentData, attribute);
-//     vector<pair<pair<string, string>, double>> expectedCounts;
-//     vector<pair<pair<string, string>, double>> realCounts;
-//     for(int i=0; i<splitData_all.size(); i++){
-//         string child_attr = splitData_all.at(i).first;
-//         vector<pair<string, vector<vector<string>>>> subSplitData_all = attribute_based_split_labelled_all(splitData_all.at(i).second, target);
-//         for(int j=0; j<subSplitData_all.size(); j++){
-//             pair<string, string> tempStringPair;
-//             tempStringPair.first = child_attr;
-//             tempStringPair.second = subSplitData_all.at(j).first;
-//             pair<pair<string, string>, double> countPair;
-//             countPair.first = tempStringPair;
-//             countPair.second = (double) 0;
-//             expectedCounts.push_back(countPair);
-//             realCounts.push_back(countPair);
-//         }
-//     }
-//     //Store real counts
-//     for(int i=0; i<splitData_all.size(); i++){
-//         string attr = splitData_all.at(i).first;
-//         int count = (int) splitData_all.at(i).second.size();
-//         for(int j=0; j<splitData_all.at(i).second.size(); j++){
-//             vector<pair<string, vector<vector<string>>>> subSplitData_all = attribute_based_split_labelled_all(splitData_all.at(i).second, target);
-//             for(int k=0; k<subSplitData_all.size(); k++){
-//                 string class_ = subSplitData_all.at(k).first;
-//                 for(int m=0; m<realCounts.size(); m++){
-//                     if((realCounts.at(m).first.first).compare(attr) == 0){
-//                         if((realCounts.at(m).first.second).compare(class_) == 0){
-//                             realCounts.at(m).second = realCounts.at(m).second + 1;
-//                         }
-//                     }
-//                 }
-//             }
-//         }
-//     }
-    
-//     //Calculate expected counts
-//     vector<pair<string, int>> parentClassCounts = getValueInstances(parentData, target);
-//     int parentTotal = 0;
-//     for(int i=0; i<parentClassCounts.size(); i++){
-//         parentTotal += parentClassCounts.at(i).second;
-//     }
-//     vector<pair<string, double>> classProportions; //store proportions for targets in parent node
-//     for(int i=0; i<parentClassCounts.size(); i++){
-//         double prop;
-//         prop = ((double) parentClassCounts.at(i).second)/((double) parentTotal);
-//         pair<string, double> temp;
-//         temp.first = parentClassCounts.at(i).first;
-//         temp.second = prop;
-//         classProportions.push_back(temp); 
-//     }
-    
-//     for(int i=0; i<splitData_all.size(); i++){
-//         string attr = splitData_all.at(i).first;
-//         int count = splitData_all.at(i).second.size();
-//         for(int j=0; j<classes.size(); j++){
-//             string class_ = classes.at(j);
-//             for(int k=0; k<expectedCounts.size(); k++){
-//                 if(((expectedCounts.at(k).first.first).compare(attr) == 0) && ((expectedCounts.at(k).first.second).compare(class_) == 0)){
-//                     double proportion = 0;
-//                     for(int m=0; m<classProportions.size(); m++){
-//                         if(classProportions.at(m).first.compare(class_) == 0){
-//                             proportion = classProportions.at(m).second;
-//                         }
-//                     }
-//                     double value = (double) proportion * (double) count;
-//                     expectedCounts.at(k).second = value;
-//                 }
-//             }
-//         }
-//     }
-//     double chiSqValue = 0;
-//     for(int i=0; i<realCounts.size(); i++){
-//         double diff = realCounts.at(i).second - expectedCounts.at(i).second;
-//         double ret = (diff*diff)/expectedCounts.at(i).second;
-//         chiSqValue += ret;
-//     }
-//     return chiSqValue;
-// }
-
-//Computes X^2 value for the chosen split attribute - using unordered_maps
-double chiSquaredValue(vector<vector<string>> parentData, int attribute, int target){
-    vector<string> classes = getUniqueAttributes(parentData, target);
-    vector<string> unqValues = getUniqueAttributes(parentData, attribute);
-    int numClasses = classes.size();
-    int numValues = unqValues.size();
-    //vector<pair<string, int>> classCountParent;
-    unordered_map<string, int> classCountParent;
-    //Count class instances in the parent node
-    for(int i=0; i<classes.size(); i++){
-        classCountParent[classes.at(i)] = 0;
-    }
-    for(int i=0; i<parentData.size(); i++){
-        classCountParent[parentData.at(i).at(target)] = classCountParent[parentData.at(i).at(target)] + 1;
-    }
-    //Store real counts and expected counts for each child node
-    vector<pair<string, vector<vector<string>>>> splitData_all = attribute_based_split_labelled_all(parentData, attribute);
-    unordered_map<string, unordered_map<string, double>> expectedCounts; //in the format outer string = attr, inner string = target
-    unordered_map<string, unordered_map<string, double>> realCounts; //in the format outer string = attr, inner string = target
-    unordered_map<string, int> childrenCounts;
-    //Store real counts
-    for(int i=0; i<parentData.size(); i++){
-        if(realCounts.count(parentData.at(i).at(attribute))){
-            if(realCounts[parentData.at(i).at(attribute)].count(parentData.at(i).at(target))){
-                realCounts[parentData.at(i).at(attribute)][parentData.at(i).at(target)] = 
-                realCounts[parentData.at(i).at(attribute)][parentData.at(i).at(target)] + 1; 
-            }
-            else{
-                realCounts[parentData.at(i).at(attribute)][parentData.at(i).at(target)] = 1;
-            }
-        }
-        else{
-            unordered_map<string, double> temp;
-            temp[parentData.at(i).at(target)] = 1;
-            realCounts[parentData.at(i).at(attribute)] = temp;
-        }
-        if(childrenCounts.count(parentData.at(i).at(attribute))){
-            childrenCounts[parentData.at(i).at(attribute)] = childrenCounts[parentData.at(i).at(attribute)] + 1;//Get total children counts
-        }
-        else{
-            childrenCounts[parentData.at(i).at(attribute)] = 1;//Get total children counts
+//Memoized critical values, indexed by significance level and then by degrees of freedom. Trees may be grown
+//concurrently, so the table is only read or extended under criticalValueLock.
+static unordered_map<double, vector<double>> criticalValueTable;
+static mutex criticalValueLock;
+
+//Solve chisqr(dof, x) = alpha for x by bisection. The p value decreases monotonically in x.
+static double solveChiSquaredCritical(int degreeFreedom, double alpha){
+    double low = 0;
+    double high = degreeFreedom + 10 * sqrt(2.0 * degreeFreedom) + 50;
+    for(int i=0; i<100 && high - low > 1e-9 * high; i++){
+        double mid = 0.5 * (low + high);
+        if(chisqr(degreeFreedom, mid) > alpha) low = mid;
+        else high = mid;
+    }
+    return 0.5 * (low + high);
+}
+
+//Extend the critical value table of significance level alpha up to maxDof, criticalValueLock must be held
+static vector<double>& fillChiSquaredCritical(int maxDof, double alpha){
+    vector<double>& table = criticalValueTable[alpha];
+    for(int dof=(int) table.size(); dof<=maxDof; dof++){
+        table.push_back(dof < 1 ? 0 : solveChiSquaredCritical(dof, alpha));
+    }
+    return table;
+}
+
+//Fill the critical value table for every degree of freedom up to maxDof at the given confidence
+void precomputeChiSquaredCritical(int maxDof, double confidence){
+    lock_guard<mutex> guard(criticalValueLock);
+    fillChiSquaredCritical(maxDof, 1 - confidence);
+}
+
+//Returns the X^2 value a statistic with the given degrees of freedom must exceed at significance alpha
+double chiSquaredCritical(int degreeFreedom, double alpha){
+    lock_guard<mutex> guard(criticalValueLock);
+    unordered_map<double, vector<double>>::const_iterator table = criticalValueTable.find(alpha);
+    if(table != criticalValueTable.end() && degreeFreedom < (int) table->second.size()) return table->second[degreeFreedom];
+    return fillChiSquaredCritical(degreeFreedom, alpha)[degreeFreedom];
+}
+
+//Build a dense row major contingency table of attribute values (rows) against classes (columns)
+vector<int> contingencyTable(const vector<vector<string>>& data, int attribute, int target, int& numValues, int& numClasses){
+    unordered_map<string, int> valueIndex = make_dict(getUniqueAttributes(data, attribute));
+    unordered_map<string, int> classIndex = make_dict(getUniqueAttributes(data, target));
+    numValues = (int) valueIndex.size();
+    numClasses = (int) classIndex.size();
+    vector<int> table(numValues * numClasses, 0);
+    for(int i=0; i<data.size(); i++){
+        table[valueIndex[data.at(i).at(attribute)] * numClasses + classIndex[data.at(i).at(target)]] += 1;
+    }
+    return table;
+}
+
+//Computes X^2 value from a dense contingency table.
+//With expected counts e_ij = r_i * c_j / N, X^2 = N * sum(o_ij^2 / (r_i * c_j)) - N, which needs no branches in the inner loop.
+double chiSquaredValue(const vector<int>& table, int numValues, int numClasses){
+    vector<double> rowSums(numValues, 0);
+    vector<double> inverseColSums(numClasses, 0);
+    double total = 0;
+    for(int i=0; i<numValues; i++){
+        const int * row = &table[i * numClasses];
+        for(int j=0; j<numClasses; j++){
+            rowSums[i] += row[j];
+            inverseColSums[j] += row[j];
         }
+        total += rowSums[i];
+    }
+    if(total == 0) return 0;
+    for(int j=0; j<numClasses; j++){
+        inverseColSums[j] = inverseColSums[j] > 0 ? 1 / inverseColSums[j] : 0;
     }
-    
-    int parentDataSize = (int) parentData.size();
-    for(int i=0; i<classes.size(); i++){
-        for(int j=0; j<unqValues.size(); j++){
-            expectedCounts[unqValues.at(j)][classes.at(i)] = 
-            ((double) childrenCounts[unqValues.at(j)] * ((double) classCountParent[classes.at(i)]/ (double) parentDataSize)); 
-        } 
+    double sum = 0;
+    for(int i=0; i<numValues; i++){
+        if(rowSums[i] == 0) continue;
+        const int * row = &table[i * numClasses];
+        double rowSum = 0;
+        for(int j=0; j<numClasses; j++){
+            double o = row[j];
+            rowSum += o * o * inverseColSums[j];
+        }
+        sum += rowSum / rowSums[i];
     }
+    return total * sum - total;
+}
 
-    double chiSqValue = 0;
-    for(int i=0; i<classes.size(); i++){
-        for(int j=0; j<unqValues.size(); j++){
-            double diff = ((double) realCounts[unqValues.at(j)][classes.at(i)]) - ((double) expectedCounts[unqValues.at(j)][classes.at(i)]);
-            double ret = (diff * diff)/expectedCounts[unqValues.at(j)][classes.at(i)];
-            chiSqValue = chiSqValue + ret;
+//Computes X^2 value for the chosen split attribute
+double chiSquaredValue(const vector<vector<string>>& parentData, int attribute, int target){
+    int numValues, numClasses;
+    vector<int> table = contingencyTable(parentData, attribute, target, numValues, numClasses);
+    return chiSquaredValue(table, numValues, numClasses);
+}
+
+//Returns true if the split described by a dense contingency table passes the chi squared test
+bool chiSquaredTest(const vector<int>& table, int numValues, int numClasses, double confidence){
+    int presentValues = 0;
+    int presentClasses = 0;
+    vector<int> colSums(numClasses, 0);
+    for(int i=0; i<numValues; i++){
+        int rowSum = 0;
+        for(int j=0; j<numClasses; j++){
+            rowSum += table[i * numClasses + j];
+            colSums[j] += table[i * numClasses + j];
         }
+        if(rowSum > 0) presentValues++;
+    }
+    for(int j=0; j<numClasses; j++){
+        if(colSums[j] > 0) presentClasses++;
     }
-    return chiSqValue;
+    int dof = (presentClasses - 1) * (presentValues - 1);
+    if(dof < 1) return false;
+    double X2 = chiSquaredValue(table, numValues, numClasses);
+    return X2 > chiSquaredCritical(dof, 1 - confidence);
 }
 
 //Returns true if the chosen attribute based on the dataset passes the chi squared test
-bool chiSquaredTest(vector<vector<string>> parentData, int attribute, double confidence, int target){
-    double alpha = 1 - confidence;
-    double X2 = chiSquaredValue(parentData, attribute, target);
-    int dof;
-    vector<string> classes = getUniqueAttributes(parentData, target);
-    vector<string> attr_values = getUniqueAttributes(parentData, attribute);
-    dof = ((int) classes.size() - 1) * ((int) attr_values.size() - 1);
-    double lookup = chiSquaredLookup(dof, alpha);
-    if(X2 > lookup) return true;
-    else return false;
+bool chiSquaredTest(const vector<vector<string>>& parentData, int attribute, double confidence, int target){
+    int numValues, numClasses;
+    vector<int> table = contingencyTable(parentData, attribute, target, numValues, numClasses);
+    return chiSquaredTest(table, numValues, numClasses, confidence);
+}
+
+//Batch log gamma for x > 0. Lanczos approximation (g = 7, n = 9) written as whole array expressions,
+//so the divisions and the packetized log run in SIMD lanes. Agrees with log_gamma() from gamma.c to
+//within 2e-14 * max(1, |log gamma(x)|) on (0, 1e6].
+ArrayXd logGamma(const ArrayXd& x){
+    static const double lanczos[9] = {0.99999999999980993, 676.5203681218851, -1259.1392167224028,
+                                      771.32342877765313, -176.61502916214059, 12.507343278686905,
+                                      -0.13857109526572012, 9.9843695780195716e-6, 1.5056327351493116e-7};
+    const double halfLog2Pi = 0.91893853320467274178;
+    //Below 0.5 evaluate at x + 1 and use log gamma(x) = log gamma(x + 1) - log(x)
+    ArrayXd shift = (x < 0.5).cast<double>();
+    ArrayXd z = x + shift - 1;
+    ArrayXd sum = ArrayXd::Constant(x.size(), lanczos[0]);
+    for(int i=1; i<9; i++){
+        sum += lanczos[i] / (z + i);
+    }
+    ArrayXd t = z + 7.5;
+    ArrayXd result = halfLog2Pi + (z + 0.5) * t.log() - t + sum.log();
+    return result - shift * x.max(DBL_MIN).log();
+}
+
+//Lanes are processed in fixed size blocks held on the stack. Iterations stop once every lane of a block
+//converged, so a few slow lanes only hold back their own block.
+typedef Array<double, Dynamic, 1, 0, 256, 1> gammaBlock;
+
+static void upperIncompleteGammaBlock(const gammaBlock& a, const gammaBlock& x, double * out){
+    const double eps = 2 * DBL_EPSILON;
+    const double tiny = 1e-300;
+    const int maxIterations = 1000;
+    gammaBlock prefix = (a * x.max(0.0).log() - x - logGamma(a)).exp();
+
+    //Series P(a, x) = prefix * sum_n x^n / (a (a + 1) ... (a + n))
+    gammaBlock xs = x.min(a + 1).max(0.0);
+    gammaBlock ap = a;
+    gammaBlock term = a.inverse();
+    gammaBlock series = term;
+    for(int n=0; n<maxIterations; n++){
+        ap += 1;
+        term *= xs / ap;
+        series += term;
+        if((term <= series * eps).all()) break;
+    }
+
+    //Continued fraction for Q(a, x) by the modified Lentz method
+    gammaBlock xc = x.max(a + 1);
+    gammaBlock b = xc + 1 - a;
+    gammaBlock c = gammaBlock::Constant(x.size(), 1 / tiny);
+    gammaBlock d = b.inverse();
+    gammaBlock fraction = d;
+    gammaBlock an, delta;
+    for(int i=1; i<maxIterations; i++){
+        an = -i * (i - a);
+        b += 2;
+        d = an * d + b;
+        d = (d.abs() < tiny).select(tiny, d);
+        c = b + an / c;
+        c = (c.abs() < tiny).select(tiny, c);
+        d = d.inverse();
+        delta = d * c;
+        fraction *= delta;
+        if(((delta - 1).abs() <= eps).all()) break;
+    }
+
+    Map<gammaBlock> result(out, x.size());
+    result = (x <= 0).select(1.0, (x < a + 1).select(1 - prefix * series, prefix * fraction));
+}
+
+//Batch regularized upper incomplete gamma Q(a, x). Lanes with x < a + 1 use the series for P(a, x),
+//the others the continued fraction for Q(a, x).
+ArrayXd upperIncompleteGamma(const ArrayXd& a, const ArrayXd& x){
+    ArrayXd result(x.size());
+    for(Index start=0; start<x.size(); start+=256){
+        Index count = min<Index>(256, x.size() - start);
+        upperIncompleteGammaBlock(a.segment(start, count), x.segment(start, count), result.data() + start);
+    }
+    return result;
+}
+
+//Batch chi squared p values, the vectorized counterpart of chisqr(dof, statistic) from chisqr.c.
+//Agrees with chisqr() to within 1e-13 absolute.
+ArrayXd chiSquaredPValues(const ArrayXd& statistics, const ArrayXd& degreeFreedom){
+    return upperIncompleteGamma(degreeFreedom / 2, statistics / 2);
+}
+
+//Chi squared statistic of every word (column) against the classes (rows) of a word count matrix.
+//Each word is scored on the 2 x k table of its own counts against the counts of all other words in each class.
+ArrayXd chiSquaredFeatureScores(const MatrixXd& counts){
+    auto C = counts.array(); //A view of counts, binding an ArrayXXd would copy the whole matrix
+    ArrayXd classTotals = C.rowwise().sum();
+    ArrayXd wordTotals = C.colwise().sum().transpose();
+    double N = classTotals.sum();
+    ArrayXd inverseClassTotals = (classTotals > 0).select(classTotals.inverse(), 0.0);
+
+    //sum_c o^2 / r_c for the word row, and for the rest row sum_c (r_c - o)^2 / r_c = N - 2 t_w + present
+    ArrayXd present = (C.square().colwise() * inverseClassTotals).colwise().sum().transpose();
+    ArrayXd absent = N - 2 * wordTotals + present;
+    ArrayXd result = N * (present / wordTotals + absent / (N - wordTotals)) - N;
+    return ((wordTotals > 0) && (wordTotals < N)).select(result, 0.0);
+}
+
+//Mutual information (in bits) between the occurrence of every word (column) and the classes (rows) of a word count matrix
+ArrayXd mutualInformationFeatureScores(const MatrixXd& counts){
+    auto C = counts.array();
+    ArrayXd classTotals = C.rowwise().sum();
+    ArrayXd wordTotals = C.colwise().sum().transpose();
+    double N = classTotals.sum();
+    ArrayXd inverseClassTotals = (classTotals > 0).select(classTotals.inverse(), 0.0);
+    ArrayXd inverseWordTotals = (wordTotals > 0).select(wordTotals.inverse(), 0.0);
+    ArrayXd inverseRestTotals = (wordTotals < N).select((N - wordTotals).inverse(), 0.0);
+
+    //P(c,w) log2(P(c,w) / (P(c) P(w))), zero counts contribute nothing
+    ArrayXXd ratio = ((C * N).colwise() * inverseClassTotals).rowwise() * inverseWordTotals.transpose();
+    ArrayXXd presentTerms = (C > 0).select(C * ratio.log(), 0.0);
+    ArrayXXd rest = (-C).colwise() + classTotals;
+    ratio = ((rest * N).colwise() * inverseClassTotals).rowwise() * inverseRestTotals.transpose();
+    ArrayXXd absentTerms = (rest > 0).select(rest * ratio.log(), 0.0);
+    return (presentTerms + absentTerms).colwise().sum().transpose() / (N * log(2.0));
+}
+
+//Returns the indices of the k highest scores in ascending index order, k must be at least 1
+vector<int> topKFeatures(const ArrayXd& scores, int k){
+    if(k < 1) throw runtime_error("topKFeatures needs k >= 1");
+    vector<int> result((int) scores.size());
+    for(int i=0; i<result.size(); i++){
+        result[i] = i;
+    }
+    if(k < (int) result.size()){
+        nth_element(result.begin(), result.begin() + k, result.end(), [&scores](int a, int b){ return scores(a) > scores(b); });
+        result.resize(k);
+    }
+    sort(result.begin(), result.end());
+    return result;
 }
 
 /*
 
 //Return vector of vector of attributes that have randomly sampled (with replacement) features. Includes target
-vector<vector<int>> bagFeaturesIndices(vector<vector<string>> dataset, int target, int numBags, int minFeatureSize){
+vector<vector<int>> bagFeaturesIndices(const vector<vector<string>>& dataset, int target, int numBags, int minFeatureSize){
     vector<vector<int>> selectedAttributes;
     vector<int> in;
     for(int i=0; i<dataset.at(0).size(); i++){
@@ -828,7 +991,7 @@ vector<vector<int>> bagFeaturesIndices(vector<vector<string>> dataset, int targe
 
 //Return vector of datasets that have randomly sampled (with replacement) features
 //Incomplete
-vector<vector<vector<string>>> bagFeatures(vector<vector<string>> dataset, vector<vector<int>> baggedIndices){
+vector<vector<vector<string>>> bagFeatures(const vector<vector<string>>& dataset, const vector<vector<int>>& baggedIndices){
     vector<vector<vector<string>>> result;
     for(int i=0; i<baggedIndices.size(); i++){
         vector<vector<string>> temp;
@@ -847,11 +1010,11 @@ vector<vector<vector<string>>> bagFeatures(vector<vector<string>> dataset, vecto
 }
 */
 //Print wrappers - polymorphism for various data types
-void println(string s){
+void println(const string& s){
     cout << s << endl;
 }
 
-void print(string s){
+void print(const string& s){
     cout << s;
 }
 
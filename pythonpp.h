@@ -23,95 +23,132 @@ using namespace Eigen;
     
 // };
 
-vector<vector<string>> read_csv(string filename);
+vector<vector<string>> read_csv(const string& filename);
 
-vector<vector<int>> read_csv_int(string filename);
+vector<vector<int>> read_csv_int(const string& filename);
 
-vector<vector<int>> * read_csv_int_p (string filename);
+vector<vector<int>> * read_csv_int_p (const string& filename);
 
-vector<vector<double>> read_csv_double(string filename);
+vector<vector<double>> read_csv_double(const string& filename);
 
-vector<int> read_vec_int(string filename);
+vector<int> read_vec_int(const string& filename);
 
-vector<double> read_vec_double(string filename);
+vector<double> read_vec_double(const string& filename);
 
-vector<string> read_lines(string filename);
+vector<string> read_lines(const string& filename);
 
-MatrixXd dfToMatrixInt(vector<vector<int>> data);
+MatrixXd dfToMatrixInt(const vector<vector<int>>& data);
 
-void writeIntVectorToFile(vector<int> arr, ofstream& file);
+void writeIntVectorToFile(const vector<int>& arr, ofstream& file);
 
-void writeIntMatrixToFile(vector<vector<int>> arr, ofstream& file);
+void writeIntMatrixToFile(const vector<vector<int>>& arr, ofstream& file);
 
-void writeDoubleVectorToFile(vector<double> arr, ofstream& file);
+void writeDoubleVectorToFile(const vector<double>& arr, ofstream& file);
 
-void writeDoubleMatrixToFile(vector<vector<double>> arr, ofstream& file);
+void writeDoubleMatrixToFile(const vector<vector<double>>& arr, ofstream& file);
 
-void write_csv(vector<vector<int>> input, string filename);
+void write_csv(const vector<vector<int>>& input, const string& filename);
 
-void write_csv(vector<vector<double>> input, string filename);
+void write_csv(const vector<vector<double>>& input, const string& filename);
 
-void write_csv(vector<vector<string>> input, string filename);
+void write_csv(const vector<vector<string>>& input, const string& filename);
 
-unordered_map<string, int> make_dict(vector<string> vocab);
+unordered_map<string, int> make_dict(const vector<string>& vocab);
 
-unordered_map<string, int> make_dict(vector<string> vocab, int offset);
+unordered_map<string, int> make_dict(const vector<string>& vocab, int offset);
 
-void printDataFrame(vector<vector<string>> data);
+void printDataFrame(const vector<vector<string>>& data);
 
-void printColumns(vector<string> data);
+void printColumns(const vector<string>& data);
 
-pair<vector<vector<string>>, vector<string>> seperateTargets(vector<vector<string>> data, int targetIndex);
+pair<vector<vector<string>>, vector<string>> seperateTargets(const vector<vector<string>>& data, int targetIndex);
 
-pair<vector<vector<int>>, vector<int>> seperateTargets(vector<vector<int>> data, int targetIndex);
+pair<vector<vector<int>>, vector<int>> seperateTargets(const vector<vector<int>>& data, int targetIndex);
 
-pair<vector<int>, vector<vector<int>>> seperateHeader(vector<vector<int>> data);
+pair<vector<int>, vector<vector<int>>> seperateHeader(const vector<vector<int>>& data);
 
-pair<vector<string>, vector<vector<string>>> seperateHeader(vector<vector<string>> data);
+pair<vector<string>, vector<vector<string>>> seperateHeader(const vector<vector<string>>& data);
+
+vector<string> stripColumn(vector<vector<string>>& data, int column);
+
+vector<int> stripColumn(vector<vector<int>>& data, int column);
+
+void shuffleDataFrameInPlace(vector<vector<string>>& data);
+
+void shuffleDataFrameInPlace(vector<vector<int>>& data);
 
 vector<vector<string>> shuffleDataFrame(vector<vector<string>> data);
 
 vector<vector<int>> shuffleDataFrame(vector<vector<int>> data);
 
-pair<vector<vector<string>>, vector<vector<string>>> train_test_split(vector<vector<string>> data, float trainRatio);
+pair<vector<vector<string>>, vector<vector<string>>> train_test_split(const vector<vector<string>>& data, float trainRatio);
+
+pair<vector<vector<int>>, vector<vector<int>>> train_test_split(const vector<vector<int>>& data, float trainRatio);
 
-pair<vector<vector<int>>, vector<vector<int>>> train_test_split(vector<vector<int>> data, float trainRatio);
+pair<vector<vector<string>>, vector<vector<string>>> train_test_split(vector<vector<string>>&& data, float trainRatio);
 
-vector<vector<vector<string>>> attribute_based_split(vector<vector<string>> data, int attribute, vector<string> values);
+pair<vector<vector<int>>, vector<vector<int>>> train_test_split(vector<vector<int>>&& data, float trainRatio);
 
-vector<string> getUniqueAttributes(vector<vector<string>> data, int attribute);
+//Sum word counts, word document frequencies and document counts per class over training rows laid out as <counts...>,<class>. Classes start at 1.
+void aggregateClassCounts(const vector<vector<int>>& data, int numClasses, int numWords, vector<vector<int>>& wordToClassCount, vector<vector<int>>& wordToClassDocFreq, vector<int>& rawCount, vector<int>& classRepresentation);
 
-double getGain(vector<vector<string>> data, string criterion, int attribute, int target);
+vector<vector<vector<string>>> attribute_based_split(const vector<vector<string>>& data, int attribute, const vector<string>& values);
 
-double getGini(vector<vector<string>> data, int target);
+vector<string> getUniqueAttributes(const vector<vector<string>>& data, int attribute);
 
-double getEntropy(vector<vector<string>> data, int target);
+double getGain(const vector<vector<string>>& data, const string& criterion, int attribute, int target);
 
-double getMisclassificationError(vector<vector<string>> data, int target);
+double getGini(const vector<vector<string>>& data, int target);
 
-vector<vector<vector<string>>> attribute_based_filter(vector<vector<string>> data, int attribute);
+double getEntropy(const vector<vector<string>>& data, int target);
 
-pair<string, vector<vector<string>>> attribute_based_split_labelled(vector<vector<string>> data, int attribute, string value);
+double getMisclassificationError(const vector<vector<string>>& data, int target);
 
-vector<pair<string, vector<vector<string>>>> attribute_based_split_labelled_all(vector<vector<string>> data, int attribute);
+vector<vector<vector<string>>> attribute_based_filter(const vector<vector<string>>& data, int attribute);
 
-int getMaxGainIndex(vector<vector<string>> data, string criterion, int target);
+pair<string, vector<vector<string>>> attribute_based_split_labelled(const vector<vector<string>>& data, int attribute, const string& value);
+
+vector<pair<string, vector<vector<string>>>> attribute_based_split_labelled_all(const vector<vector<string>>& data, int attribute);
+
+int getMaxGainIndex(const vector<vector<string>>& data, const string& criterion, int target);
 
 double chiSquaredLookup(double degreeFreedom, double alpha);
 
-double chiSquaredValue(vector<vector<string>> parentData, int attribute, int target);
+void precomputeChiSquaredCritical(int maxDof, double confidence);
+
+double chiSquaredCritical(int degreeFreedom, double alpha);
+
+vector<int> contingencyTable(const vector<vector<string>>& data, int attribute, int target, int& numValues, int& numClasses);
+
+double chiSquaredValue(const vector<int>& table, int numValues, int numClasses);
+
+double chiSquaredValue(const vector<vector<string>>& parentData, int attribute, int target);
+
+bool chiSquaredTest(const vector<int>& table, int numValues, int numClasses, double confidence);
+
+bool chiSquaredTest(const vector<vector<string>>& parentData, int attribute, double confidence, int target);
+
+ArrayXd logGamma(const ArrayXd& x);
+
+ArrayXd upperIncompleteGamma(const ArrayXd& a, const ArrayXd& x);
+
+ArrayXd chiSquaredPValues(const ArrayXd& statistics, const ArrayXd& degreeFreedom);
+
+ArrayXd chiSquaredFeatureScores(const MatrixXd& counts);
+
+ArrayXd mutualInformationFeatureScores(const MatrixXd& counts);
 
-bool chiSquaredTest(vector<vector<string>> parentData, int attribute, double confidence, int target);
+vector<int> topKFeatures(const ArrayXd& scores, int k);
 
-vector<pair<string, int>> getValueInstances(vector<vector<string>> data, int attribute);
+vector<pair<string, int>> getValueInstances(const vector<vector<string>>& data, int attribute);
 
-vector<vector<int>> bagFeaturesIndices(vector<vector<string>> dataset, int target, int numBags, int minFeatureSize);
+vector<vector<int>> bagFeaturesIndices(const vector<vector<string>>& dataset, int target, int numBags, int minFeatureSize);
 
-vector<vector<vector<string>>> bagFeatures(vector<vector<string>> dataset, vector<vector<int>> baggedIndices);
+vector<vector<vector<string>>> bagFeatures(const vector<vector<string>>& dataset, const vector<vector<int>>& baggedIndices);
 
-void println(string s);
+void println(const string& s);
 
-void print(string s);
+void print(const string& s);
 
 void println(int s);
 
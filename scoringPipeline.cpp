@@ -0,0 +1,343 @@
+#include "scoringPipeline.h"
+#include "profiler.h"
+#include <iostream>
+#include <fstream>
+#include <stdexcept> // runtime_error
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+using namespace std;
+
+// Block of whole csv lines and the results of its rows
+struct scoringChunk {
+    size_t index;  // Position of the block in the file
+    string text;
+    vector<int> predictions;
+    vector<int> labels;
+};
+
+static double elapsedMs(chrono::steady_clock::time_point begin){
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+// Parse one row into a sparse document over the numWords columns after the id, and its label if the row has one
+static void parseRow(const char * begin, const char * end, int numWords, bool labelled, sparseDocument& document, int& label){
+    document.clear();
+    label = 0;
+    if(labelled){
+        const char * comma = end;
+        while(comma > begin && *(comma - 1) != ',') comma--;
+        label = atoi(comma);
+        end = comma > begin ? comma - 1 : begin;
+    }
+
+    const char * p = begin;
+    while(p < end && *p != ',') p++; // Skip the id
+    int column = 0;
+    while(p < end && column < numWords){
+        p++;
+        bool negative = p < end && *p == '-';
+        if(negative) p++;
+        int value = 0;
+        while(p < end && *p >= '0' && *p <= '9'){
+            value = value * 10 + (*p - '0');
+            p++;
+        }
+        while(p < end && *p != ',') p++;
+        if(value != 0) document.push_back(make_pair(column, negative ? -value : value));
+        column++;
+    }
+}
+
+pipelineStats scoreCsvPipelined(const string& file, int numWords, bool labelled, const function<int(const sparseDocument&)>& predict,
+                                const string& submissionFile, int firstId, int numThreads){
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ifstream input(file, ios::binary);
+    if(!input.is_open()) throw runtime_error("Could not open file"); // Make sure the file is open
+    ofstream submission;
+    if(!submissionFile.empty()) submission.open(submissionFile);
+
+    if(numThreads <= 0) numThreads = max(1, (int) thread::hardware_concurrency());
+    const size_t blockSize = 1 << 20;
+    const size_t maxInFlight = 4 * numThreads; // Blocks read but not yet written, bounds memory
+
+    pipelineStats stats = {0, 0, 0.0, 0.0, 0.0, 0.0, numThreads};
+    mutex lock;
+    condition_variable workAvailable;
+    condition_variable spaceAvailable;
+    condition_variable chunkReady;
+    deque<scoringChunk> work;
+    map<size_t, scoringChunk> ready;
+    size_t numChunks = 0;
+    size_t written = 0;
+    bool readerDone = false;
+
+    thread reader([&](){
+        double busy = 0.0;
+        string carry;
+        vector<char> buffer(blockSize);
+        while(true){
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            input.read(buffer.data(), blockSize);
+            size_t got = (size_t) input.gcount();
+            scoringChunk chunk;
+            if(got == 0){
+                chunk.text = move(carry);
+            } else {
+                // Hand over whole lines only, the partial last line starts the next block
+                size_t cut = got;
+                while(cut > 0 && buffer[cut - 1] != '\n') cut--;
+                if(cut == 0){
+                    carry.append(buffer.data(), got);
+                    busy += elapsedMs(begin);
+                    continue;
+                }
+                chunk.text = move(carry);
+                chunk.text.append(buffer.data(), cut);
+                carry.assign(buffer.data() + cut, got - cut);
+            }
+            busy += elapsedMs(begin);
+
+            if(!chunk.text.empty()){
+                unique_lock<mutex> guard(lock);
+                spaceAvailable.wait(guard, [&](){ return numChunks - written < maxInFlight; });
+                chunk.index = numChunks++;
+                work.push_back(move(chunk));
+                workAvailable.notify_one();
+            }
+            if(got == 0) break;
+        }
+        unique_lock<mutex> guard(lock);
+        stats.readMs = busy;
+        readerDone = true;
+        workAvailable.notify_all();
+        chunkReady.notify_all();
+    });
+
+    vector<double> workerBusy(numThreads, 0.0);
+    vector<thread> workers;
+    for(int t=0; t<numThreads; t++){
+        workers.push_back(thread([&, t](){
+            sparseDocument document;
+            while(true){
+                scoringChunk chunk;
+                {
+                    unique_lock<mutex> guard(lock);
+                    workAvailable.wait(guard, [&](){ return !work.empty() || readerDone; });
+                    if(work.empty()) return;
+                    chunk = move(work.front());
+                    work.pop_front();
+                }
+
+                chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+                const char * p = chunk.text.data();
+                const char * end = p + chunk.text.size();
+                while(p < end){
+                    const char * lineEnd = p;
+                    while(lineEnd < end && *lineEnd != '\n') lineEnd++;
+                    const char * rowEnd = lineEnd;
+                    if(rowEnd > p && *(rowEnd - 1) == '\r') rowEnd--;
+                    if(rowEnd > p){
+                        int label;
+                        parseRow(p, rowEnd, numWords, labelled, document, label);
+                        chunk.predictions.push_back(predict(document));
+                        chunk.labels.push_back(label);
+                    }
+                    p = lineEnd + 1;
+                }
+                profileCount("bytes_parsed", (long long) chunk.text.size());
+                profileCount("rows_parsed", (long long) chunk.predictions.size());
+                chunk.text = string();
+                workerBusy[t] += elapsedMs(begin);
+
+                unique_lock<mutex> guard(lock);
+                size_t index = chunk.index;
+                ready[index] = move(chunk);
+                if(index == written) chunkReady.notify_one();
+            }
+        }));
+    }
+
+    // Writer, runs on this thread and keeps the original row order
+    double writeBusy = 0.0;
+    string out;
+    if(submission.is_open()) out += "id,class\n";
+    while(true){
+        scoringChunk chunk;
+        {
+            unique_lock<mutex> guard(lock);
+            chunkReady.wait(guard, [&](){ return ready.count(written) > 0 || (readerDone && written == numChunks); });
+            if(ready.count(written) == 0) break;
+            chunk = move(ready[written]);
+            ready.erase(written);
+            written++;
+            spaceAvailable.notify_one();
+            if(ready.count(written) > 0) chunkReady.notify_one();
+        }
+
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        for(int i=0; i<chunk.predictions.size(); i++){
+            if(labelled && chunk.predictions[i] == chunk.labels[i]) stats.correct++;
+            if(submission.is_open()){
+                out += to_string(firstId + stats.rows);
+                out += ',';
+                out += to_string(chunk.predictions[i]);
+                out += '\n';
+            }
+            stats.rows++;
+        }
+        if(out.size() >= blockSize){
+            submission.write(out.data(), out.size());
+            out.clear();
+        }
+        writeBusy += elapsedMs(begin);
+    }
+
+    reader.join();
+    for(thread& worker : workers){
+        worker.join();
+    }
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    if(submission.is_open()){
+        submission.write(out.data(), out.size());
+        submission.close();
+    }
+    writeBusy += elapsedMs(begin);
+
+    stats.writeMs = writeBusy;
+    for(double busy : workerBusy){
+        stats.scoreMs += busy;
+    }
+    stats.totalMs = elapsedMs(start);
+    return stats;
+}
+
+bool readSparseCsv(const string& file, int numWords, vector<sparseDocument>& documents, vector<int>& ids, vector<int>& labels){
+    ifstream input(file);
+    if(!input.is_open()) throw runtime_error("Could not open file"); // Make sure the file is open
+    bool labelled = false;
+    string line;
+    while(getline(input, line)){
+        if(line.empty()) continue;
+        char * next;
+        ids.push_back((int) strtol(line.c_str(), &next, 10));
+        documents.push_back(sparseDocument());
+        sparseDocument& document = documents.back();
+        int column = 0;
+        int value = 0;
+        while(*next == ','){
+            value = (int) strtol(next + 1, &next, 10);
+            if(value != 0 && column < numWords) document.push_back(make_pair(column, value));
+            column++;
+        }
+        labelled = column > numWords;
+        labels.push_back(labelled ? value : 0);
+        profileCount("bytes_parsed", (long long) line.size() + 1);
+    }
+    profileCount("rows_parsed", (long long) documents.size());
+    return labelled;
+}
+
+bool isSparseBinary(const string& file){
+    ifstream input(file, ios::binary);
+    char magic[4];
+    return input.read(magic, sizeof(magic)) && memcmp(magic, "SPC1", sizeof(magic)) == 0;
+}
+
+bool readSparseBinary(const string& file, int numWords, vector<sparseDocument>& documents, vector<int>& ids, vector<int>& labels){
+    ifstream input(file, ios::binary);
+    if(!input.is_open()) throw runtime_error("Could not open file"); // Make sure the file is open
+    char magic[4];
+    int32_t header[3]; // numDocuments, vocabularySize, numClasses
+    if(!input.read(magic, sizeof(magic)) || memcmp(magic, "SPC1", sizeof(magic)) != 0 || !input.read((char *) header, sizeof(header))){
+        throw runtime_error("Not a sparse binary corpus: " + file);
+    }
+    documents.reserve(documents.size() + header[0]);
+    vector<int32_t> entries;
+    for(int d=0; d<header[0]; d++){
+        int32_t fields[3]; // id, class, numEntries
+        if(!input.read((char *) fields, sizeof(fields)) || fields[2] < 0) throw runtime_error("Truncated sparse binary corpus: " + file);
+        entries.resize(2 * (size_t) fields[2]);
+        if(!input.read((char *) entries.data(), entries.size() * sizeof(int32_t))) throw runtime_error("Truncated sparse binary corpus: " + file);
+        ids.push_back(fields[0]);
+        labels.push_back(fields[1]);
+        documents.push_back(sparseDocument());
+        sparseDocument& document = documents.back();
+        for(size_t e=0; e<entries.size(); e+=2){
+            if(entries[e] >= 0 && entries[e] < numWords && entries[e + 1] != 0) document.push_back(make_pair(entries[e], entries[e + 1]));
+        }
+        profileCount("bytes_parsed", (long long) (sizeof(fields) + entries.size() * sizeof(int32_t)));
+    }
+    profileCount("rows_parsed", (long long) header[0]);
+    return header[2] > 0;
+}
+
+pipelineStats scoreSparseBinary(const string& file, int numWords, bool labelled, const function<int(const sparseDocument&)>& predict,
+                                const string& submissionFile, int numThreads){
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if(numThreads <= 0) numThreads = max(1, (int) thread::hardware_concurrency());
+    pipelineStats stats = {0, 0, 0.0, 0.0, 0.0, 0.0, numThreads};
+
+    vector<sparseDocument> documents;
+    vector<int> ids;
+    vector<int> labels;
+    readSparseBinary(file, numWords, documents, ids, labels);
+    stats.readMs = elapsedMs(start);
+
+    vector<int> predictions(documents.size());
+    vector<double> workerBusy(numThreads, 0.0);
+    vector<thread> workers;
+    for(int t=0; t<numThreads; t++){
+        workers.push_back(thread([&, t](){
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            size_t first = documents.size() * t / numThreads;
+            size_t last = documents.size() * (t + 1) / numThreads;
+            for(size_t i=first; i<last; i++){
+                predictions[i] = predict(documents[i]);
+            }
+            workerBusy[t] = elapsedMs(begin);
+        }));
+    }
+    for(thread& worker : workers){
+        worker.join();
+    }
+    for(double busy : workerBusy){
+        stats.scoreMs += busy;
+    }
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    string out;
+    if(!submissionFile.empty()) out += "id,class\n";
+    for(size_t i=0; i<predictions.size(); i++){
+        if(labelled && predictions[i] == labels[i]) stats.correct++;
+        if(!submissionFile.empty()){
+            out += to_string(ids[i]);
+            out += ',';
+            out += to_string(predictions[i]);
+            out += '\n';
+        }
+    }
+    stats.rows = predictions.size();
+    if(!submissionFile.empty()){
+        ofstream submission(submissionFile);
+        submission.write(out.data(), out.size());
+    }
+    stats.writeMs = elapsedMs(begin);
+    stats.totalMs = elapsedMs(start);
+    return stats;
+}
+
+void printPipelineStats(const pipelineStats& stats){
+    cout << "Time to read file = " << (long) stats.readMs << "[ms]" << endl;
+    cout << "Time to parse and predict = " << (long) stats.scoreMs << "[ms] over " << stats.numThreads << " threads" << endl;
+    cout << "Time to write results = " << (long) stats.writeMs << "[ms]" << endl;
+    cout << "Total time to predict classes = " << (long) stats.totalMs << "[ms]" << endl;
+}
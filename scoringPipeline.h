@@ -0,0 +1,50 @@
+#ifndef H__SCORING_PIPELINE
+#define H__SCORING_PIPELINE
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "tokenizer.h"
+
+using namespace std;
+
+// Summary of a pipelined scoring run. Stage times are busy times, worker time is summed over all workers.
+struct pipelineStats {
+    size_t rows;
+    size_t correct;  // Rows whose prediction matched the label, labelled files only
+    double readMs;
+    double scoreMs;
+    double writeMs;
+    double totalMs;
+    int numThreads;
+};
+
+// Score a count csv of "<id>,<count>,...,<count>[,<label>]" rows. Only the numWords columns after the id are
+// words, later columns such as a label that is not asked for are skipped. A reader thread cuts the file into blocks of
+// whole lines, a pool of numThreads workers parses the rows into sparse documents and calls predict, and a
+// writer consumes the blocks in file order. When submissionFile is not empty the writer emits "id,class" rows
+// numbered from firstId through one large buffer. numThreads <= 0 uses every hardware thread.
+// predict is called concurrently and must not modify the model.
+pipelineStats scoreCsvPipelined(const string& file, int numWords, bool labelled, const function<int(const sparseDocument&)>& predict,
+                                const string& submissionFile, int firstId, int numThreads = 0);
+
+// Read a whole count csv into sparse documents over the numWords columns after the id. Rows with a column after
+// the vocabulary are labelled and that column is returned in labels, 0 otherwise. Returns whether the file is labelled.
+bool readSparseCsv(const string& file, int numWords, vector<sparseDocument>& documents, vector<int>& ids, vector<int>& labels);
+
+// Whether a file is in the sparse binary corpus format of generate.out, described in synthetic.h ("SPC1" magic)
+bool isSparseBinary(const string& file);
+
+// Read a whole sparse binary corpus, keeping the entries of the first numWords words. Same results as
+// readSparseCsv, the labels are 0 when the corpus has no classes. Throws on a truncated file.
+bool readSparseBinary(const string& file, int numWords, vector<sparseDocument>& documents, vector<int>& ids, vector<int>& labels);
+
+// scoreCsvPipelined for a sparse binary corpus: the file is read at once and its documents are split over
+// numThreads workers. Submission rows carry the ids stored in the file.
+pipelineStats scoreSparseBinary(const string& file, int numWords, bool labelled, const function<int(const sparseDocument&)>& predict,
+                                const string& submissionFile, int numThreads = 0);
+
+// Print the stage timings of a run in the usual "[ms]" format
+void printPipelineStats(const pipelineStats& stats);
+
+#endif
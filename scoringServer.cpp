@@ -0,0 +1,318 @@
+#include "scoringServer.h"
+#include "pythonpp.h"
+#include "scoringPipeline.h"
+#include <iostream>
+#include <stdexcept> // runtime_error
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Largest frame accepted by the server, larger requests are treated as ill-formed
+const uint32_t maxFrameBytes = 64 << 20;
+
+static bool readFully(int fd, void * buffer, size_t length){
+    char * p = (char *) buffer;
+    while(length > 0){
+        ssize_t got = read(fd, p, length);
+        if(got <= 0) return false;
+        p += got;
+        length -= got;
+    }
+    return true;
+}
+
+static bool writeFully(int fd, const void * buffer, size_t length){
+    const char * p = (const char *) buffer;
+    while(length > 0){
+        ssize_t sent = send(fd, p, length, MSG_NOSIGNAL);
+        if(sent <= 0) return false;
+        p += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+template <typename T>
+static void append(string& buffer, T value){
+    buffer.append((const char *) &value, sizeof(T));
+}
+
+static sockaddr_un socketAddress(const string& socketPath){
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socketPath.size() >= sizeof(address.sun_path)) throw runtime_error("Socket path too long");
+    strcpy(address.sun_path, socketPath.c_str());
+    return address;
+}
+
+// Buffers one pool thread reuses across requests
+struct requestBuffers {
+    vector<char> request;
+    string response;
+    sparseDocument document;
+    vector<int> classes;
+    vector<double> probabilities;
+};
+
+// Answer one request of a client. Returns false when the client disconnected or sent an ill-formed frame.
+static bool serveRequest(int fd, int numFeatures, int numClasses, requestBuffers& buffers,
+                         const function<int(const sparseDocument&)>& predict,
+                         const function<vector<double>(const sparseDocument&)>& posterior){
+    vector<char>& request = buffers.request;
+    string& response = buffers.response;
+    sparseDocument& document = buffers.document;
+    vector<int>& classes = buffers.classes;
+    vector<double>& probabilities = buffers.probabilities;
+
+    uint32_t length;
+    if(!readFully(fd, &length, sizeof(length)) || length > maxFrameBytes) return false;
+    request.resize(length);
+    if(!readFully(fd, request.data(), length)) return false;
+
+    // Bounds checked reads from the payload
+    size_t offset = 0;
+    auto next = [&](uint32_t& value){
+        if(offset + sizeof(value) > request.size()) return false;
+        memcpy(&value, request.data() + offset, sizeof(value));
+        offset += sizeof(value);
+        return true;
+    };
+
+    uint32_t flags, numDocuments;
+    if(!next(flags) || !next(numDocuments)) return false;
+    bool wantProbabilities = (flags & requestProbabilities) != 0;
+    classes.clear();
+    probabilities.clear();
+    for(uint32_t d=0; d<numDocuments; d++){
+        uint32_t numEntries;
+        if(!next(numEntries) || numEntries > (request.size() - offset) / 8) return false;
+        document.clear();
+        for(uint32_t e=0; e<numEntries; e++){
+            uint32_t index, count;
+            if(!next(index) || !next(count) || index >= (uint32_t) numFeatures) return false;
+            document.push_back(make_pair((int) index, (int) count));
+        }
+        classes.push_back(predict(document));
+        if(wantProbabilities){
+            vector<double> p = posterior(document);
+            probabilities.insert(probabilities.end(), p.begin(), p.end());
+        }
+    }
+
+    response.clear();
+    append(response, (uint32_t) 0);
+    append(response, numDocuments);
+    append(response, (uint32_t) (wantProbabilities ? numClasses : 0));
+    for(int c : classes){
+        append(response, (int32_t) c);
+    }
+    for(double p : probabilities){
+        append(response, p);
+    }
+    uint32_t payload = (uint32_t) (response.size() - sizeof(uint32_t));
+    memcpy(&response[0], &payload, sizeof(payload));
+    return writeFully(fd, response.data(), response.size());
+}
+
+void serveModel(const string& socketPath, int numThreads, int numFeatures, int numClasses,
+                const function<int(const sparseDocument&)>& predict,
+                const function<vector<double>(const sparseDocument&)>& posterior){
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0) throw runtime_error("Could not create socket");
+    sockaddr_un address = socketAddress(socketPath);
+    unlink(socketPath.c_str());
+    if(bind(listener, (sockaddr *) &address, sizeof(address)) < 0) throw runtime_error("Could not bind socket");
+    if(listen(listener, 128) < 0) throw runtime_error("Could not listen on socket");
+
+    // Pool threads hand served connections back through the pipe so the poll loop wakes up for them
+    int wake[2];
+    if(pipe(wake) < 0) throw runtime_error("Could not create pipe");
+    fcntl(wake[0], F_SETFL, O_NONBLOCK);
+
+    if(numThreads <= 0) numThreads = max(1, (int) thread::hardware_concurrency());
+    cout << "Serving on " << socketPath << " with " << numThreads << " threads" << endl;
+
+    mutex lock;
+    condition_variable requestWaiting;
+    deque<int> ready;     // Connections with a request to answer
+    vector<int> returned; // Connections answered and waiting to be polled again
+    vector<thread> pool;
+    for(int t=0; t<numThreads; t++){
+        pool.push_back(thread([&](){
+            requestBuffers buffers;
+            while(true){
+                int fd;
+                {
+                    unique_lock<mutex> guard(lock);
+                    requestWaiting.wait(guard, [&](){ return !ready.empty(); });
+                    fd = ready.front();
+                    ready.pop_front();
+                }
+                if(!serveRequest(fd, numFeatures, numClasses, buffers, predict, posterior)){
+                    close(fd);
+                    continue;
+                }
+                {
+                    unique_lock<mutex> guard(lock);
+                    returned.push_back(fd);
+                }
+                char byte = 0;
+                if(write(wake[1], &byte, 1) < 0) cerr << "Could not wake the poll loop" << endl;
+            }
+        }));
+    }
+
+    // Idle connections are polled here and a readable one is queued for a single request, so a pool
+    // thread is only held for one request at a time and any number of clients share the pool
+    vector<pollfd> polled = {{listener, POLLIN, 0}, {wake[0], POLLIN, 0}};
+    while(true){
+        if(poll(polled.data(), polled.size(), -1) < 0) continue;
+        vector<int> readable;
+        for(size_t i=2; i<polled.size(); ){
+            if(polled[i].revents != 0){
+                readable.push_back(polled[i].fd);
+                polled[i] = polled.back();
+                polled.pop_back();
+            } else {
+                i++;
+            }
+        }
+        if(polled[0].revents & POLLIN){
+            int fd = accept(listener, NULL, NULL);
+            if(fd >= 0) polled.push_back({fd, POLLIN, 0});
+        }
+        if(polled[1].revents & POLLIN){
+            char bytes[256];
+            while(read(wake[0], bytes, sizeof(bytes)) > 0){}
+            unique_lock<mutex> guard(lock);
+            for(int fd : returned){
+                polled.push_back({fd, POLLIN, 0});
+            }
+            returned.clear();
+        }
+        if(!readable.empty()){
+            unique_lock<mutex> guard(lock);
+            ready.insert(ready.end(), readable.begin(), readable.end());
+            requestWaiting.notify_all();
+        }
+    }
+}
+
+scoringClient::scoringClient(const string& socketPath){
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) throw runtime_error("Could not create socket");
+    sockaddr_un address = socketAddress(socketPath);
+    if(connect(fd, (sockaddr *) &address, sizeof(address)) < 0){
+        close(fd);
+        throw runtime_error("Could not connect to " + socketPath);
+    }
+}
+
+scoringClient::~scoringClient(){
+    close(fd);
+}
+
+vector<int> scoringClient::classify(const vector<sparseDocument>& documents, bool wantProbabilities, vector<double>& probabilities){
+    string request;
+    append(request, (uint32_t) 0);
+    append(request, (uint32_t) (wantProbabilities ? requestProbabilities : 0));
+    append(request, (uint32_t) documents.size());
+    for(const sparseDocument& document : documents){
+        append(request, (uint32_t) document.size());
+        for(const pair<int, int>& word : document){
+            append(request, (uint32_t) word.first);
+            append(request, (uint32_t) word.second);
+        }
+    }
+    uint32_t payload = (uint32_t) (request.size() - sizeof(uint32_t));
+    memcpy(&request[0], &payload, sizeof(payload));
+    if(!writeFully(fd, request.data(), request.size())) throw runtime_error("Could not send request");
+
+    uint32_t length;
+    if(!readFully(fd, &length, sizeof(length))) throw runtime_error("Server closed the connection");
+    vector<char> response(length);
+    if(!readFully(fd, response.data(), length) || length < 2 * sizeof(uint32_t)) throw runtime_error("Truncated response");
+
+    uint32_t numDocuments, numClasses;
+    memcpy(&numDocuments, response.data(), sizeof(uint32_t));
+    memcpy(&numClasses, response.data() + sizeof(uint32_t), sizeof(uint32_t));
+    size_t expected = 2 * sizeof(uint32_t) + (size_t) numDocuments * sizeof(int32_t) + (size_t) numDocuments * numClasses * sizeof(double);
+    if(length != expected) throw runtime_error("Malformed response");
+
+    vector<int> classes(numDocuments);
+    memcpy(classes.data(), response.data() + 2 * sizeof(uint32_t), numDocuments * sizeof(int32_t));
+    probabilities.resize((size_t) numDocuments * numClasses);
+    memcpy(probabilities.data(), response.data() + 2 * sizeof(uint32_t) + numDocuments * sizeof(int32_t), probabilities.size() * sizeof(double));
+    return classes;
+}
+
+int runLoadGenerator(int argc, char** argv){
+    if(argc < 8){
+        cerr << "Usage: " << argv[0] << " loadgen <socketPath> <counts.csv> <vocab.txt> <numClients> <requestsPerClient> <batchSize> [probabilities]" << endl;
+        return 0;
+    }
+    string socketPath = argv[2];
+    int numClients = atoi(argv[5]);
+    int requestsPerClient = atoi(argv[6]);
+    int batchSize = atoi(argv[7]);
+    bool wantProbabilities = argc > 8 && strcmp(argv[8], "probabilities") == 0;
+
+    // Rows are "<id>,<count>,...[,<class>]", only the vocabulary columns are sent so labelled files can be replayed too
+    vector<sparseDocument> documents;
+    vector<int> ids;
+    vector<int> labels;
+    readSparseCsv(argv[3], (int) read_lines(argv[4]).size(), documents, ids, labels);
+    if(documents.empty()) throw runtime_error("No documents in " + string(argv[3]));
+
+    vector<vector<double>> latencies(numClients);
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    vector<thread> clients;
+    for(int c=0; c<numClients; c++){
+        clients.push_back(thread([&, c](){
+            try {
+                scoringClient client(socketPath);
+                vector<sparseDocument> batch(batchSize);
+                vector<double> probabilities;
+                for(int r=0; r<requestsPerClient; r++){
+                    for(int b=0; b<batchSize; b++){
+                        batch[b] = documents[((size_t) (c * requestsPerClient + r) * batchSize + b) % documents.size()];
+                    }
+                    chrono::steady_clock::time_point sent = chrono::steady_clock::now();
+                    client.classify(batch, wantProbabilities, probabilities);
+                    latencies[c].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - sent).count());
+                }
+            } catch(const runtime_error& error){
+                cerr << "Client " << c << ": " << error.what() << endl;
+            }
+        }));
+    }
+    for(thread& client : clients){
+        client.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    vector<double> all;
+    for(const vector<double>& l : latencies){
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    sort(all.begin(), all.end());
+    if(all.empty()) return 0;
+    cout << "Requests: " << all.size() << ", documents per request: " << batchSize << endl;
+    cout << "p50 latency = " << (long) all[all.size() / 2] << "[us]" << endl;
+    cout << "p99 latency = " << (long) all[min(all.size() - 1, all.size() * 99 / 100)] << "[us]" << endl;
+    cout << "Max latency = " << (long) all.back() << "[us]" << endl;
+    cout << "Throughput = " << (long) (all.size() * batchSize / seconds) << " documents/s" << endl;
+    return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef H__SCORING_SERVER
+#define H__SCORING_SERVER
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "tokenizer.h"
+
+using namespace std;
+
+// Length prefixed binary protocol over a Unix domain socket. Every field is a 32 bit integer in host
+// byte order (the socket is local), every frame starts with the number of payload bytes that follow.
+//   request:  <flags> <numDocuments> { <numEntries> { <index> <count> } x numEntries } x numDocuments
+//             flags bit 0 asks for class probabilities
+//   response: <numDocuments> <numClasses, 0 without probabilities> { <class> } x numDocuments
+//             followed by numDocuments x numClasses probabilities as doubles
+// An ill-formed request closes the connection.
+const uint32_t requestProbabilities = 1;
+
+// Load once, then answer requests until the process is killed. Idle connections are polled and every request is
+// answered by one of a pool of numThreads threads (every hardware thread when numThreads <= 0), so any number of
+// clients share the pool. A thread blocks until the whole frame of the request it took has arrived.
+// Indices must lie in [0, numFeatures). predict and posterior are called concurrently and must not modify the model.
+void serveModel(const string& socketPath, int numThreads, int numFeatures, int numClasses,
+                const function<int(const sparseDocument&)>& predict,
+                const function<vector<double>(const sparseDocument&)>& posterior);
+
+// Blocking client for serveModel, one connection per object
+class scoringClient {
+
+    public:
+        scoringClient(const string& socketPath);
+        ~scoringClient();
+        scoringClient(const scoringClient&) = delete;
+        scoringClient& operator=(const scoringClient&) = delete;
+
+        // Classes of a batch of documents. With wantProbabilities, probabilities receives numDocuments x numClasses values.
+        vector<int> classify(const vector<sparseDocument>& documents, bool wantProbabilities, vector<double>& probabilities);
+
+    private:
+        int fd;
+};
+
+// loadgen <socketPath> <counts.csv> <vocab.txt> <numClients> <requestsPerClient> <batchSize> [probabilities]
+// Replay the rows of a count file, labelled or not, against a running server from concurrent clients and report
+// latency percentiles. Only the columns of the vocabulary the server was loaded with are sent.
+int runLoadGenerator(int argc, char** argv);
+
+#endif
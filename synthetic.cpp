@@ -0,0 +1,135 @@
+#include "synthetic.h"
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+
+using namespace std;
+
+syntheticCorpus::syntheticCorpus(const syntheticCorpusConfig& c) : config(c){
+    cdf.resize(config.vocabularySize);
+    double total = 0.0;
+    for(int r=0; r<config.vocabularySize; r++){
+        total += pow(r + 1.0, -config.zipfExponent);
+        cdf[r] = total;
+    }
+    for(double& p : cdf){
+        p /= total;
+    }
+    tokensPerDocument = max(1, (int) lround(config.density * config.vocabularySize));
+
+    classCdf.resize(config.numClasses);
+    total = 0.0;
+    for(int c=0; c<config.numClasses; c++){
+        total += pow(c + 1.0, -config.classSkew);
+        classCdf[c] = total;
+    }
+    for(double& p : classCdf){
+        p /= total;
+    }
+}
+
+vector<pair<int, int>> syntheticCorpus::document(int _class, mt19937& rng) const{
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    int shift = (int) ((long long) (_class - 1) * config.vocabularySize / config.numClasses);
+    vector<int> words(tokensPerDocument);
+    for(int t=0; t<tokensPerDocument; t++){
+        int rank = (int) (lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin());
+        rank = min(rank, config.vocabularySize - 1);
+        // Half of the tokens are topical: the same rank lands on a class specific word
+        words[t] = uniform(rng) < 0.5 ? rank : (rank + shift) % config.vocabularySize;
+    }
+    sort(words.begin(), words.end());
+
+    vector<pair<int, int>> result;
+    for(int word : words){
+        if(!result.empty() && result.back().first == word) result.back().second += 1;
+        else result.push_back(make_pair(word, 1));
+    }
+    return result;
+}
+
+int syntheticCorpus::drawClass(mt19937& rng) const{
+    double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+    int c = (int) (lower_bound(classCdf.begin(), classCdf.end(), u) - classCdf.begin());
+    return min(c, config.numClasses - 1) + 1;
+}
+
+vector<vector<int>> syntheticCorpus::rows(int numDocuments, int firstId, mt19937& rng) const{
+    vector<vector<int>> result(numDocuments);
+    for(int i=0; i<numDocuments; i++){
+        int _class = drawClass(rng);
+        vector<int>& row = result[i];
+        row.assign(config.vocabularySize + 2, 0);
+        row[0] = firstId + i;
+        for(const pair<int, int>& word : document(_class, rng)){
+            row[word.first + 1] = word.second;
+        }
+        row.back() = _class;
+    }
+    return result;
+}
+
+void appendCsvRow(string& out, int id, const vector<pair<int, int>>& document, int vocabularySize, int _class){
+    // Runs of zero columns are copied from a prebuilt ",0,0,..." string
+    static const string zeros = [](){
+        string z;
+        for(int i=0; i<4096; i++) z += ",0";
+        return z;
+    }();
+    out += to_string(id);
+    int next = 0;
+    for(const pair<int, int>& word : document){
+        for(int gap = word.first - next; gap > 0; gap -= 4096){
+            out.append(zeros, 0, 2 * min(gap, 4096));
+        }
+        out += ',';
+        out += to_string(word.second);
+        next = word.first + 1;
+    }
+    for(int gap = vocabularySize - next; gap > 0; gap -= 4096){
+        out.append(zeros, 0, 2 * min(gap, 4096));
+    }
+    if(_class > 0){
+        out += ',';
+        out += to_string(_class);
+    }
+    out += '\n';
+}
+
+template <typename T>
+static void appendRaw(string& out, T value){
+    out.append((const char *) &value, sizeof(T));
+}
+
+void appendBinaryHeader(string& out, int numDocuments, int vocabularySize, int numClasses){
+    out += "SPC1";
+    appendRaw(out, (int32_t) numDocuments);
+    appendRaw(out, (int32_t) vocabularySize);
+    appendRaw(out, (int32_t) numClasses);
+}
+
+void appendBinaryDocument(string& out, int id, int _class, const vector<pair<int, int>>& document){
+    appendRaw(out, (int32_t) id);
+    appendRaw(out, (int32_t) _class);
+    appendRaw(out, (int32_t) document.size());
+    for(const pair<int, int>& word : document){
+        appendRaw(out, (int32_t) word.first);
+        appendRaw(out, (int32_t) word.second);
+    }
+}
+
+vector<string> syntheticVocabulary(int vocabularySize){
+    vector<string> result(vocabularySize);
+    for(int j=0; j<vocabularySize; j++){
+        result[j] = "w" + to_string(j);
+    }
+    return result;
+}
+
+vector<string> syntheticLabels(int numClasses){
+    vector<string> result(numClasses);
+    for(int i=0; i<numClasses; i++){
+        result[i] = "class." + to_string(i + 1);
+    }
+    return result;
+}
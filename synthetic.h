@@ -0,0 +1,63 @@
+#ifndef H__SYNTHETIC
+#define H__SYNTHETIC
+
+#include <string>
+#include <vector>
+#include <random>
+
+using namespace std;
+
+// Shape of a synthetic word count corpus
+struct syntheticCorpusConfig {
+    int numDocuments;
+    int vocabularySize;
+    int numClasses;
+    double density;      // Expected fraction of the vocabulary a document uses, sets the document length
+    double zipfExponent; // Word frequencies fall off as 1 / rank^zipfExponent
+    double classSkew;    // Class c is drawn with probability proportional to 1 / c^classSkew, 0 for balanced classes
+    unsigned seed;
+};
+
+// Draws documents whose words follow a Zipf law. Every class shifts the rank to word mapping by its own
+// offset for half of the tokens, so classes share common words but differ in their topical ones.
+class syntheticCorpus {
+
+    public:
+        syntheticCorpus(const syntheticCorpusConfig& config);
+
+        // Sparse (word, count) pairs of one document of a class (classes start at 1), sorted by word
+        vector<pair<int, int>> document(int _class, mt19937& rng) const;
+
+        // Class of the next document, skewed towards the first classes by classSkew
+        int drawClass(mt19937& rng) const;
+
+        // Dense rows in the layout of training.csv: <id>,<counts...>,<class>, ids start at firstId
+        vector<vector<int>> rows(int numDocuments, int firstId, mt19937& rng) const;
+
+        const syntheticCorpusConfig config;
+
+    private:
+        // Cumulative Zipf probabilities over the ranks
+        vector<double> cdf;
+        int tokensPerDocument;
+
+        // Cumulative class probabilities
+        vector<double> classCdf;
+};
+
+// Append one document as a dense csv row "<id>,<counts...>[,<class>]", the class column is left out when _class is 0
+void appendCsvRow(string& out, int id, const vector<pair<int, int>>& document, int vocabularySize, int _class);
+
+// Sparse binary corpus, all fields 32 bit integers in host byte order:
+//   header:   "SPC1" <numDocuments> <vocabularySize> <numClasses>
+//   document: <id> <class> <numEntries> { <word> <count> } x numEntries
+void appendBinaryHeader(string& out, int numDocuments, int vocabularySize, int numClasses);
+
+void appendBinaryDocument(string& out, int id, int _class, const vector<pair<int, int>>& document);
+
+// Word and class names in the layout of vocabulary.txt and newsgrouplabels.txt
+vector<string> syntheticVocabulary(int vocabularySize);
+
+vector<string> syntheticLabels(int numClasses);
+
+#endif
@@ -0,0 +1,182 @@
+#include "tokenizer.h"
+#include <algorithm>
+#include <stdexcept> // runtime_error
+#include <string.h>
+#include <unordered_map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// FNV-1a over the bytes, seeded and finished with the murmur3 64 bit mixer
+static uint64_t hashToken(const char * token, size_t length, uint32_t seed){
+    uint64_t h = 14695981039346656037ULL ^ ((uint64_t) seed * 0x9E3779B97F4A7C15ULL);
+    for(size_t i=0; i<length; i++){
+        h ^= (unsigned char) token[i];
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+perfectHashVocabulary::perfectHashVocabulary(const vector<string>& vocab){
+    // Later duplicates win, like make_dict
+    unordered_map<string, int> unique;
+    for(int i=0; i<vocab.size(); i++){
+        unique[vocab[i]] = i;
+    }
+    vector<pair<string, int>> words(unique.begin(), unique.end());
+    int n = (int) words.size();
+    int numBuckets = max(1, n / 4);
+    seeds.assign(numBuckets, 0);
+    slotIndex.assign(max(1, n), -1);
+    slotOffset.assign(max(1, n) + 1, 0);
+
+    vector<vector<int>> buckets(numBuckets);
+    for(int i=0; i<n; i++){
+        buckets[hashToken(words[i].first.data(), words[i].first.size(), 0) % numBuckets].push_back(i);
+    }
+
+    // Place the largest buckets first while most slots are still free
+    vector<int> order(numBuckets);
+    for(int b=0; b<numBuckets; b++){
+        order[b] = b;
+    }
+    sort(order.begin(), order.end(), [&buckets](int a, int b){ return buckets[a].size() > buckets[b].size(); });
+
+    vector<int> slotWord(max(1, n), -1);
+    vector<int> slots;
+    for(int b : order){
+        if(buckets[b].empty()) break;
+        for(uint32_t seed=1; ; seed++){
+            if(seed == 0) throw runtime_error("Could not build perfect hash for vocabulary");
+            slots.clear();
+            bool fits = true;
+            for(int w : buckets[b]){
+                int slot = (int) (hashToken(words[w].first.data(), words[w].first.size(), seed) % n);
+                if(slotWord[slot] >= 0 || find(slots.begin(), slots.end(), slot) != slots.end()){
+                    fits = false;
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if(fits){
+                seeds[b] = seed;
+                for(int i=0; i<slots.size(); i++){
+                    slotWord[slots[i]] = buckets[b][i];
+                }
+                break;
+            }
+        }
+    }
+
+    // Lay the words out in slot order so a lookup touches one contiguous key
+    for(int s=0; s<n; s++){
+        slotOffset[s] = (uint32_t) keys.size();
+        keys += words[slotWord[s]].first;
+        slotIndex[s] = words[slotWord[s]].second;
+    }
+    slotOffset[n] = (uint32_t) keys.size();
+    if(n == 0) slotIndex.clear();
+}
+
+int perfectHashVocabulary::lookup(const char * token, size_t length) const{
+    if(slotIndex.empty()) return -1;
+    uint32_t seed = seeds[hashToken(token, length, 0) % seeds.size()];
+    if(seed == 0) return -1; // Empty bucket
+    size_t slot = hashToken(token, length, seed) % slotIndex.size();
+    size_t keyLength = slotOffset[slot + 1] - slotOffset[slot];
+    if(keyLength != length || memcmp(keys.data() + slotOffset[slot], token, length) != 0) return -1;
+    return slotIndex[slot];
+}
+
+int perfectHashVocabulary::size() const{
+    return (int) slotIndex.size();
+}
+
+// Call f(token, length) for every lowercase token of the text
+template <typename F>
+static void forEachToken(const char * text, size_t length, F f){
+    string token;
+    for(size_t i=0; i<=length; i++){
+        unsigned char c = i < length ? (unsigned char) text[i] : ' ';
+        if((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80){
+            token += (char) c;
+        } else if(c >= 'A' && c <= 'Z'){
+            token += (char) (c - 'A' + 'a');
+        } else if(!token.empty()){
+            f(token.data(), token.size());
+            token.clear();
+        }
+    }
+}
+
+// Sum the values of equal slots of a sorted (slot, value) list, dropping slots that cancel out
+static sparseDocument accumulate(vector<pair<int, int>>& entries){
+    sort(entries.begin(), entries.end());
+    sparseDocument result;
+    for(int i=0; i<entries.size(); i++){
+        if(result.empty() || result.back().first != entries[i].first){
+            if(!result.empty() && result.back().second == 0) result.pop_back();
+            result.push_back(entries[i]);
+        } else {
+            result.back().second += entries[i].second;
+        }
+    }
+    if(!result.empty() && result.back().second == 0) result.pop_back();
+    return result;
+}
+
+sparseDocument tokenizeText(const char * text, size_t length, const perfectHashVocabulary& vocab){
+    vector<pair<int, int>> entries;
+    forEachToken(text, length, [&](const char * token, size_t tokenLength){
+        int id = vocab.lookup(token, tokenLength);
+        if(id >= 0) entries.push_back(make_pair(id, 1));
+    });
+    return accumulate(entries);
+}
+
+sparseDocument hashText(const char * text, size_t length, int bits, bool signedHashing){
+    const uint64_t mask = (1ULL << bits) - 1;
+    vector<pair<int, int>> entries;
+    forEachToken(text, length, [&](const char * token, size_t tokenLength){
+        uint64_t h = hashToken(token, tokenLength, 0x5eed);
+        int sign = (signedHashing && (h >> 63)) ? -1 : 1;
+        entries.push_back(make_pair((int) (h & mask), sign));
+    });
+    return accumulate(entries);
+}
+
+// Memory map a file and pass its bytes to f
+template <typename F>
+static sparseDocument withMappedFile(const string& filename, F f){
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) throw runtime_error("Could not open file"); // Make sure the file is open
+    struct stat info;
+    fstat(fd, &info);
+    if(info.st_size == 0){
+        close(fd);
+        return f("", 0);
+    }
+    void * data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) throw runtime_error("Could not map file");
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
+    sparseDocument result = f((const char *) data, (size_t) info.st_size);
+    munmap(data, info.st_size);
+    return result;
+}
+
+sparseDocument tokenizeFile(const string& filename, const perfectHashVocabulary& vocab){
+    return withMappedFile(filename, [&](const char * text, size_t length){ return tokenizeText(text, length, vocab); });
+}
+
+sparseDocument hashFile(const string& filename, int bits, bool signedHashing){
+    return withMappedFile(filename, [&](const char * text, size_t length){ return hashText(text, length, bits, signedHashing); });
+}
@@ -0,0 +1,52 @@
+#ifndef H__TOKENIZER
+#define H__TOKENIZER
+
+#include <string>
+#include <vector>
+#include <utility> // pair
+#include <stdint.h>
+
+using namespace std;
+
+// Sparse word counts of one document as (vocabulary index, count) pairs sorted by index
+typedef vector<pair<int, int>> sparseDocument;
+
+// Minimal perfect hash over a fixed vocabulary (hash and displace). Every word maps to its own slot
+// with two hash evaluations and one string compare, unknown tokens return -1.
+class perfectHashVocabulary {
+
+    public:
+        perfectHashVocabulary(const vector<string>& vocab);
+
+        // Vocabulary index of a token, -1 if the token is not in the vocabulary
+        int lookup(const char * token, size_t length) const;
+
+        int size() const;
+
+    private:
+        // Displacement seed of every bucket
+        vector<uint32_t> seeds;
+
+        // Vocabulary index stored in every slot
+        vector<int> slotIndex;
+
+        // Word stored in every slot, as offsets into keys
+        vector<uint32_t> slotOffset;
+        string keys;
+};
+
+// Split text into lowercase tokens and count the ones found in the vocabulary.
+// Tokens are runs of ASCII letters and digits and of UTF-8 multibyte sequences, everything else separates them.
+sparseDocument tokenizeText(const char * text, size_t length, const perfectHashVocabulary& vocab);
+
+// Memory map a raw text file and tokenize it as a single document
+sparseDocument tokenizeFile(const string& filename, const perfectHashVocabulary& vocab);
+
+// Hashing trick: map every token of the text straight to one of 2^bits feature slots, no vocabulary needed.
+// With signedHashing the top hash bit decides whether the token adds or subtracts, so collisions cancel out on average.
+sparseDocument hashText(const char * text, size_t length, int bits, bool signedHashing);
+
+// Memory map a raw text file and hash it as a single document
+sparseDocument hashFile(const string& filename, int bits, bool signedHashing);
+
+#endif